@@ -6,7 +6,9 @@
 
 #include <QToolButton>
 #include <QFrame>
+#include <QPointer>
 #include <map>
+#include <algorithm>
 
 class CQPaletteArea;
 class CQPaletteAreaTitle;
@@ -18,12 +20,23 @@ class CQPalettePreview;
 
 class CQPaletteGroup;
 class CQPaletteAreaPage;
+class CQPaletteAreaFactoryPage;
 
 class CQSplitterArea;
 class CQWidgetResizer;
 class CQRubberBand;
 
 class QScrollArea;
+class QTimer;
+
+//! small unit of page work run by the palette area manager when idle
+class CQPaletteAreaWorkItem {
+ public:
+  virtual ~CQPaletteAreaWorkItem() { }
+
+  //! do work (return true if more work remains and item should be run again)
+  virtual bool exec() = 0;
+};
 
 //! palette area manager creates palette areas on all four sides of the main
 //! window and controls palette like children which can be moved between each
@@ -51,7 +64,45 @@ class CQPaletteAreaMgr : public QObject {
 
   void hidePage(CQPaletteAreaPage *page);
 
+  //! get/set hibernation of unused factory page widgets (off by default)
+  bool hibernate() const { return hibernate_; }
+  void setHibernate(bool hibernate);
+
+  //! get/set time (msecs) after which unused factory page widgets are hibernated
+  int hibernateTime() const { return hibernateTime_; }
+  void setHibernateTime(int t);
+
+  //! get/set memory budget (bytes) of factory page widgets (0 for none)
+  qint64 hibernateBudget() const { return hibernateBudget_; }
+  void setHibernateBudget(qint64 budget);
+
+  //! add idle work item for page (item is owned by manager and deleted when done,
+  //! when removed or, if page is deleted, on next run)
+  void addWork(CQPaletteAreaPage *page, CQPaletteAreaWorkItem *item);
+
+  //! remove idle work items for page
+  void removeWork(CQPaletteAreaPage *page);
+
+  //! get/set time (msecs) spent running idle work per event loop turn
+  //! (at least one item is run per turn)
+  int workBudget() const { return workBudget_; }
+  void setWorkBudget(int t) { workBudget_ = std::max(t, 0); }
+
+ private slots:
+  //! hibernate unused factory page widgets
+  void hibernateSlot();
+
+  //! run idle work items (visible pages first) within time budget
+  void workSlot();
+
  private:
+  //! update hibernation check timer
+  void updateHibernateTimer();
+
+  //! add/remove factory page tracked for hibernation
+  void addFactoryPage(CQPaletteAreaPage *page);
+  void removeFactoryPage(CQPaletteAreaPage *page);
+
   //! get dock area name
   QString dockAreaName(Qt::DockWidgetArea area) const;
 
@@ -82,13 +133,44 @@ class CQPaletteAreaMgr : public QObject {
   friend class CQPaletteArea;
   friend class CQPaletteWindow;
   friend class CQPaletteAreaTitle;
+  friend class CQPaletteGroup;
 
   typedef std::vector<CQPaletteArea *>       Areas;
   typedef std::map<Qt::DockWidgetArea,Areas> Palettes;
 
-  QMainWindow   *window_;     //! parent main window
-  Palettes       palettes_;   //! list of palettes (one per area)
-  CQRubberBand  *rubberBand_; //! rubber band
+  typedef std::vector<QPointer<CQPaletteAreaFactoryPage> > FactoryPages;
+  typedef std::vector<CQPaletteAreaFactoryPage *>          FactoryPageArray;
+
+  struct FactoryPageLastUsedCmp {
+    bool operator()(const CQPaletteAreaFactoryPage *p1, const CQPaletteAreaFactoryPage *p2) const;
+  };
+
+  struct WorkItem {
+    QPointer<CQPaletteAreaPage>  page;
+    CQPaletteAreaWorkItem       *item;
+    int                          priority;
+  };
+
+  typedef std::vector<WorkItem> WorkItems;
+
+  struct WorkItemPriorityCmp {
+    bool operator()(const WorkItem &w1, const WorkItem &w2) const {
+      return w1.priority < w2.priority;
+    }
+  };
+
+  QMainWindow   *window_;          //! parent main window
+  Palettes       palettes_;        //! list of palettes (one per area)
+  CQRubberBand  *rubberBand_;      //! rubber band
+  FactoryPages   factoryPages_;    //! factory pages (for hibernation)
+  bool           hibernate_;       //! hibernate unused factory page widgets
+  int            hibernateTime_;   //! unused time (msecs) before hibernation
+  qint64         hibernateBudget_; //! factory page widget memory budget (0 if none)
+  QTimer        *hibernateTimer_;  //! hibernation check timer
+  WorkItems      work_;            //! queued idle work items
+  WorkItems      runWork_;         //! idle work items being run
+  int            workBudget_;      //! idle work time (msecs) per event loop turn
+  QTimer        *workTimer_;       //! idle work timer
 };
 
 //------
@@ -200,6 +282,9 @@ class CQPaletteArea : public CQDockArea {
   //! update preview widgets and rects
   void updatePreview();
 
+  //! update visibility state of pages
+  void updatePageVisibility();
+
   //! add child window
   void addWindow(CQPaletteWindow *window);
 
@@ -213,6 +298,8 @@ class CQPaletteArea : public CQDockArea {
 
   void updateSplitterSizes();
 
+  //! get copy of pages of all windows (use windows() and CQPaletteWindow::pages() to
+  //! iterate without copying)
   Pages getPages() const;
 
   Qt::DockWidgetAreas calcAllowedAreas() const;
@@ -374,7 +461,10 @@ class CQPaletteWindow : public QFrame {
 
   void hidePage(CQPaletteAreaPage *page);
 
-  void movePage(CQPaletteAreaPage *page, CQPaletteWindow *newWindow);
+  void movePage(CQPaletteAreaPage *page, CQPaletteWindow *newWindow, int pos=-1);
+
+  //! get visible pages in tab order (valid until pages are added, removed or moved)
+  const Pages &pages() const;
 
   CQPaletteAreaPage *currentPage() const;
 
@@ -403,6 +493,7 @@ class CQPaletteWindow : public QFrame {
  private:
   friend class CQPaletteArea;
   friend class CQPaletteWindowTitle;
+  friend class CQPaletteGroup;
 
   bool isFirstArea() const;
 
@@ -413,6 +504,7 @@ class CQPaletteWindow : public QFrame {
   //! set parent area
   void setArea(CQPaletteArea *area);
 
+  //! get copy of pages (for loops which move pages)
   Pages getPages() const;
 
   uint numPages() const;
@@ -458,6 +550,12 @@ class CQPaletteWindow : public QFrame {
 
   Qt::DockWidgetAreas calcAllowedAreas() const;
 
+  //! update for changed page allowed areas
+  void updatePageAllowedAreas(CQPaletteAreaPage *page);
+
+  //! update area size constraints for changed current page min/max size
+  void updateSizeConstraints();
+
   void updateTitle();
 
   void resizeEvent(QResizeEvent *);
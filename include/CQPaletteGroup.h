@@ -3,15 +3,26 @@
 
 #include <CQTabBar.h>
 
-#include <QStackedWidget>
+#include <QWidget>
+#include <QLabel>
 #include <QIcon>
+#include <QImage>
+#include <QHash>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QVariant>
 #include <map>
+#include <vector>
 
 class CQPaletteGroup;
 class CQPaletteWindow;
 class CQPaletteGroupTabBar;
 class CQPaletteGroupStack;
+class CQPaletteGroupThumbnailTip;
 class CQPaletteAreaPage;
+class CQPaletteAreaFactoryPage;
 
 #define CQPaletteGroupMgrInst CQPaletteGroupMgr::getInstance()
 
@@ -21,19 +32,8 @@ class CQPaletteGroupMgr {
 
   CQPaletteGroup *createGroup(CQPaletteWindow *window);
 
-  void removeGroup(CQPaletteGroup *group);
-
-  CQPaletteGroup *getGroup(const QString &name) const;
-
-  CQPaletteGroup *getGroupFromTabBar(const QString &name) const;
-
  private:
   CQPaletteGroupMgr();
-
- private:
-  typedef std::vector<CQPaletteGroup *> Groups;
-
-  Groups groups_;
 };
 
 // class to hold a tabbed set of widgets displayed in a palette sub window
@@ -68,6 +68,11 @@ class CQPaletteGroup : public QWidget {
 
   void removePage(CQPaletteAreaPage *page);
 
+  // move pages (in order) to tab position of other group (-1 for end) with single update
+  // (pages must be a copy, not the array returned by pages())
+  void movePages(const PageArray &pages, CQPaletteGroup *toGroup, int pos=-1,
+                 CQPaletteAreaPage *currentPage=0);
+
   void showPage(CQPaletteAreaPage *page);
 
   void hidePage(CQPaletteAreaPage *page);
@@ -80,8 +85,27 @@ class CQPaletteGroup : public QWidget {
 
   CQPaletteAreaPage *getPage(int i) const;
 
+  CQPaletteAreaPage *getPageForIndex(int ind) const;
+
+  // visible pages in tab order (valid until pages are added, removed or moved)
+  const PageArray &pages() const { return tabPages_; }
+
   void getPages(PageArray &pages) const;
 
+  void updatePageStatus(CQPaletteAreaPage *page);
+
+  void updatePageTitle(CQPaletteAreaPage *page);
+
+  void updatePageAllowedAreas(CQPaletteAreaPage *page);
+
+  void updatePageSize(CQPaletteAreaPage *page);
+
+  int getPageTab(CQPaletteAreaPage *page) const;
+
+  void updatePageVisibility();
+
+  bool isCollapsed() const;
+
   QSize sizeHint() const;
 
  signals:
@@ -92,26 +116,35 @@ class CQPaletteGroup : public QWidget {
 
   void pressTabIndex(int ind);
 
-  void tabMovePageSlot(const QString &fromName, int fromIndex, const QString &toName, int toIndex);
+  void tabMovedSlot(int ind, int pos);
+
+  void tabMovePageSlot(CQTabBar *fromBar, int fromIndex, int toPos);
 
  private:
+  void addTabPage(int ind, CQPaletteAreaPage *page, bool updateStack=true);
+
+  void removeTabPage(CQPaletteAreaPage *page);
+
+  void trackPage(CQPaletteAreaPage *page);
+
   void updateCurrentPage();
 
   void updateLayout();
 
-  CQPaletteAreaPage *getPageForIndex(int ind) const;
-
   void showEvent(QShowEvent *);
 
   void resizeEvent(QResizeEvent *);
 
  private:
   typedef std::map<uint,CQPaletteAreaPage*> Pages;
+  typedef QHash<uint,int>                   PageTabs;
 
   CQPaletteWindow      *window_;
   CQPaletteGroupTabBar *tabbar_;
   CQPaletteGroupStack  *stack_;
-  Pages                 pages_;
+  Pages                 pages_;    // all pages (including hidden) by id
+  PageArray             tabPages_; // visible pages in tab order
+  PageTabs              pageTabs_; // visible page id to tab index
 };
 
 //------
@@ -123,14 +156,18 @@ class CQPaletteGroupTabBar : public CQTabBar {
  public:
   CQPaletteGroupTabBar(CQPaletteGroup *group);
 
+  CQPaletteGroup *group() const { return group_; }
+
   void updateDockArea();
 
-  void addPage(CQPaletteAreaPage *page);
+  int addPage(CQPaletteAreaPage *page);
 
-  void insertPage(int ind, CQPaletteAreaPage *page);
+  int insertPage(int ind, CQPaletteAreaPage *page);
 
   void removePage(CQPaletteAreaPage *page);
 
+  void updatePageStatus(int ind, CQPaletteAreaPage *page);
+
   uint getPageId(int ind) const;
 
   QSize sizeHint() const;
@@ -138,13 +175,31 @@ class CQPaletteGroupTabBar : public CQTabBar {
   QSize minimumSizeHint() const;
 
  private:
-  CQPaletteGroup *group_;
+  bool showTabToolTip(int ind, const QPoint &gpos);
+
+  void hideTabToolTip();
+
+ private:
+  CQPaletteGroup             *group_;
+  CQPaletteGroupThumbnailTip *thumbnailTip_; // page thumbnail popup (collapsed group)
 };
 
 //------
 
-// stacked widget
-class CQPaletteGroupStack : public QStackedWidget {
+// popup showing page thumbnail for tab of collapsed group
+class CQPaletteGroupThumbnailTip : public QLabel {
+  Q_OBJECT
+
+ public:
+  CQPaletteGroupThumbnailTip(QWidget *parent);
+
+  void showPage(CQPaletteAreaPage *page, const QPoint &gpos);
+};
+
+//------
+
+// stack of page widgets (only the current page widget is shown and laid out)
+class CQPaletteGroupStack : public QWidget {
   Q_OBJECT
 
  public:
@@ -156,6 +211,35 @@ class CQPaletteGroupStack : public QStackedWidget {
   void removePage(CQPaletteAreaPage *page);
 
   void setPage(CQPaletteAreaPage *page);
+
+  void replaceWidget(QWidget *oldWidget, QWidget *newWidget);
+
+  QWidget *currentWidget() const { return current_; }
+
+  int count() const { return widgets_.size(); }
+
+  QSize sizeHint() const;
+
+  QSize minimumSizeHint() const;
+
+ private:
+  void addWidget(QWidget *w);
+
+  void removeWidget(QWidget *w);
+
+  void setCurrentWidget(QWidget *w);
+
+  bool event(QEvent *e);
+
+  void resizeEvent(QResizeEvent *);
+
+  void childEvent(QChildEvent *e);
+
+ private:
+  typedef std::vector<QWidget *> Widgets;
+
+  Widgets  widgets_; // page widgets
+  QWidget *current_; // current page widget
 };
 
 //------
@@ -163,6 +247,17 @@ class CQPaletteGroupStack : public QStackedWidget {
 class CQPaletteAreaPage : public QObject {
   Q_OBJECT
 
+  Q_ENUMS(Visibility)
+
+ public:
+  // page visibility (why page contents can't be seen)
+  enum Visibility {
+    Hidden,    // page hidden or not in a group
+    Inactive,  // not current page of its group
+    Collapsed, // current page but window/area collapsed or hidden
+    Visible    // contents can be seen
+  };
+
  public:
   CQPaletteAreaPage(QWidget *w=0);
 
@@ -183,25 +278,89 @@ class CQPaletteAreaPage : public QObject {
   virtual void setHidden(bool hidden) { hidden_ = hidden; }
 
   bool widthResizable() const { return widthResizable_; }
-  virtual void setWidthResizable(bool resizable) { widthResizable_ = resizable; }
+  virtual void setWidthResizable(bool resizable);
 
   bool heightResizable() const { return heightResizable_; }
-  virtual void setHeightResizable(bool resizable) { heightResizable_ = resizable; }
+  virtual void setHeightResizable(bool resizable);
 
-  virtual void setFixedWidth (int width ) { fixedWidth_  = width ; setWidthResizable (false); }
-  virtual void setFixedHeight(int height) { fixedHeight_ = height; setHeightResizable(false); }
+  virtual void setFixedWidth (int width );
+  virtual void setFixedHeight(int height);
 
   virtual QString windowTitle() const { return ""; }
 
-  virtual QString title() const { return ""; }
-  virtual QIcon   icon () const { return QIcon(); }
+  // tab title/icon and allowed dock areas (set by page, consumers are notified on change)
+  // NOTE: these were virtual getters; subclasses must now call the setters instead of
+  // overriding title(), icon() or allowedAreas() (overrides no longer compile or are ignored)
+  const QString &title() const { return title_; }
+  void setTitle(const QString &title);
+
+  const QIcon &icon() const { return icon_; }
+  void setIcon(const QIcon &icon);
+
+  Qt::DockWidgetAreas allowedAreas() const { return allowedAreas_; }
+  void setAllowedAreas(Qt::DockWidgetAreas areas);
 
-  virtual Qt::DockWidgetAreas allowedAreas() const { return Qt::AllDockWidgetAreas; }
+  // tab status (tab redraws are rate limited so can be set on every update)
+  const QString &badge() const { return badge_; }
+  virtual void setBadge(const QString &badge);
 
+  int count() const { return count_; }
+  virtual void setCount(int count);
+
+  double progress() const { return progress_; }
+  virtual void setProgress(double progress);
+
+  // min/max size (cached until widget layout or min/max size changes)
   void getMinMaxWidth (int &min_w, int &max_w) const;
   void getMinMaxHeight(int &min_h, int &max_h) const;
 
+  // visibility state (updated by group and on widget show/hide)
+  Visibility visibility() const { return visibility_; }
+
+  bool isShown() const { return visibility_ == Visible; }
+
+  void updateVisibility();
+
+  // thumbnail of page contents (grabbed when page stops being visible after a change)
+  const QImage &thumbnail() const { return thumbnail_; }
+
+  // notify contents changed (thumbnail is regrabbed next time page is hidden)
+  void setContentsChanged() { thumbnailDirty_ = true; }
+
+ signals:
+  void titleChanged();
+  void iconChanged();
+  void allowedAreasChanged();
+
+  void visibilityChanged(CQPaletteAreaPage::Visibility visibility);
+
+  // page contents became visible/not visible
+  void pageShown();
+  void pageHidden();
+
+ protected:
+  // hook for pages to pause/resume expensive updates
+  virtual void visibilityEvent(Visibility) { }
+
+  void invalidateMinMax() { minMaxValid_ = false; }
+
  private:
+  friend class CQPaletteGroupStack;
+
+  Visibility calcVisibility() const;
+
+  void updateMinMax() const;
+
+  void updateThumbnail();
+
+  bool eventFilter(QObject *obj, QEvent *e);
+
+ private slots:
+  void thumbnailSlot();
+
+ private:
+  typedef QFutureWatcher<QImage> ThumbnailWatcher;
+
   static uint lastId_;
 
   CQPaletteGroup     *group_;           // parent group
@@ -213,6 +372,115 @@ class CQPaletteAreaPage : public QObject {
   int                 fixedHeight_;     // fixed height
   bool                widthResizable_;  // resizable
   bool                heightResizable_; // resizable
+  QString             title_;           // tab title
+  QIcon               icon_;            // tab icon
+  Qt::DockWidgetAreas allowedAreas_;    // allowed dock areas
+  QString             badge_;           // tab badge text
+  int                 count_;           // tab count
+  double              progress_;        // tab progress (negative if none)
+  Visibility          visibility_;      // visibility state
+  mutable bool        minMaxValid_;     // widget min/max size valid
+  mutable QSize       widgetMinSize_;   // widget min size
+  mutable QSize       widgetMaxSize_;   // widget max size
+  mutable QSize       widgetSetMinSize_; // widget explicit min size (when cached)
+  QImage              thumbnail_;       // scaled contents image
+  bool                thumbnailDirty_;  // contents changed since thumbnail grabbed
+  ThumbnailWatcher   *thumbnailWatcher_; // watcher for thumbnail scale
+};
+
+//------
+
+// non-GUI loader for factory page data (runs on a thread pool thread so must not
+// access widgets, long loads should check isCancelled)
+class CQPaletteAreaPageLoader {
+ public:
+  CQPaletteAreaPageLoader() { }
+
+  virtual ~CQPaletteAreaPageLoader() { }
+
+  bool isCancelled() const { return cancelled_.loadAcquire(); }
+
+  void cancel() { cancelled_.storeRelease(1); }
+
+  virtual QVariant load() = 0;
+
+ private:
+  QAtomicInt cancelled_; // set when page no longer wants result
+};
+
+//------
+
+// page whose widget is built by createWidget the first time it becomes current
+// (an empty placeholder widget is used until then)
+//
+// pages can also supply a loader (createLoader) to load their data off the GUI
+// thread before the widget is built. The placeholder is shown while loading and
+// the data is passed to applyData once the widget is built.
+class CQPaletteAreaFactoryPage : public CQPaletteAreaPage {
+  Q_OBJECT
+
+ public:
+  CQPaletteAreaFactoryPage();
+
+ ~CQPaletteAreaFactoryPage();
+
+  bool isRealized() const { return realized_; }
+
+  const QSize &minimumSize() const { return minSize_; }
+  void setMinimumSize(const QSize &size);
+
+  void realize();
+
+  // destroy widget (state is saved and restored when next realized)
+  void hibernate();
+
+  bool isActive() const;
+
+  qint64 lastUsed() const { return lastUsed_; }
+  void touch();
+
+  virtual qint64 memoryCost() const;
+
+  // async data load (started on first use if not already loaded)
+  bool isLoaded () const { return loaded_; }
+  bool isLoading() const { return loadWatcher_ != 0; }
+
+  void load();
+
+  void cancelLoad();
+
+ signals:
+  void dataLoaded();
+
+ protected:
+  virtual QWidget *createWidget() = 0;
+
+  // hooks for async data load (loader is owned by page, 0 if data loaded by createWidget)
+  virtual CQPaletteAreaPageLoader *createLoader() { return 0; }
+  virtual void applyData(const QVariant &) { }
+
+  // hooks to save/restore widget state over hibernation
+  virtual QVariant saveState() const { return QVariant(); }
+  virtual void restoreState(const QVariant &) { }
+
+ private slots:
+  void visibilitySlot();
+
+  void loadedSlot();
+
+ private:
+  typedef QSharedPointer<CQPaletteAreaPageLoader> LoaderP;
+  typedef QFutureWatcher<QVariant>                LoadWatcher;
+
+  bool              realized_;    // is widget built
+  QPointer<QWidget> placeholder_; // placeholder widget until built
+  QSize             minSize_;     // minimum size before widget is built
+  QVariant          state_;       // widget state saved by hibernate
+  qint64            lastUsed_;    // last time widget was in use (msecs since epoch)
+  bool              loaded_;      // is data loaded
+  QVariant          data_;        // loaded data (kept to rebuild widget after hibernate)
+  LoaderP           loader_;      // current loader (shared with worker thread)
+  LoadWatcher      *loadWatcher_; // watcher for current load
 };
 
 #endif
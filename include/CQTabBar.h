@@ -3,14 +3,27 @@
 
 #include <QTabBar>
 #include <QToolButton>
+#include <QFrame>
 #include <QIcon>
 #include <QVariant>
+#include <QHash>
+#include <QSet>
+#include <QPixmap>
+#include <QElapsedTimer>
+#include <QStaticText>
 
 class QMimeData;
+class QVariantAnimation;
+class QTimer;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
 
 class CQTabBarButton;
 class CQTabBarScrollButton;
+class CQTabBarMenu;
 class QStylePainter;
+class QStyleOptionTab;
 
 /*!
  * \ingroup WinFWCore
@@ -28,12 +41,17 @@ class CQTabBar : public QWidget {
   Q_PROPERTY(bool                allowNoTab  READ allowNoTab  WRITE setAllowNoTab )
   Q_PROPERTY(Qt::ToolButtonStyle buttonStyle READ buttonStyle WRITE setButtonStyle)
   Q_PROPERTY(QSize               iconSize    READ iconSize    WRITE setIconSize   )
+  Q_PROPERTY(bool                renderCache READ renderCache WRITE setRenderCache)
 
   Q_ENUMS(Position)
 
  private:
   enum { TAB_BORDER=8, RESIZE_WIDTH=5 };
 
+  enum { SCROLL_TIME=250, SCROLL_IDLE_TIME=200, FLING_TIME=600, STRIP_VIEWS=3 };
+
+  enum { STATUS_TIME=100 };
+
  public:
   // tab position
   enum Position {
@@ -101,6 +119,10 @@ class CQTabBar : public QWidget {
   //! get icon width
   int iconWidth() const { return iw_; }
 
+  //! get/set whether rendered tabs are cached (for styles with expensive drawing)
+  bool renderCache() const { return renderCache_; }
+  void setRenderCache(bool cache);
+
   //! set text for tab
   void setTabText(int index, const QString &text);
 
@@ -116,6 +138,15 @@ class CQTabBar : public QWidget {
   //! set whether tab is pending
   void setTabPending(int index, bool pending);
 
+  //! set tab badge text (redraw is rate limited)
+  void setTabBadge(int index, const QString &badge);
+
+  //! set tab count (redraw is rate limited)
+  void setTabCount(int index, int count);
+
+  //! set tab progress (0.0 to 1.0, negative for none, redraw is rate limited)
+  void setTabProgress(int index, double progress);
+
   //! get/set tab data
   QVariant tabData(int index) const;
   void setTabData(int index, const QVariant &data);
@@ -138,9 +169,26 @@ class CQTabBar : public QWidget {
   //! set icon size
   void setIconSize(const QSize &size);
 
+  //! scroll so tab is fully visible
+  void ensureTabVisible(int index);
+
   //! update sizes of tabs
   void updateSizes();
 
+  //! invalidate cached tab sizes
+  void invalidateSizes();
+
+  //! begin batch of tab changes (defer layout and redraw to endUpdate)
+  void beginUpdate();
+  //! end batch of tab changes
+  void endUpdate();
+
+ protected:
+  //! hook to show custom tooltip for tab (return false for default text tooltip)
+  virtual bool showTabToolTip(int /*index*/, const QPoint & /*gpos*/) { return false; }
+  //! hook to hide custom tooltip
+  virtual void hideTabToolTip() { }
+
  private:
   //! get tab button
   CQTabBarButton *tabButton(int index) const;
@@ -148,9 +196,64 @@ class CQTabBar : public QWidget {
   //! get tab button array pos
   int tabButtonPos(int index) const;
 
+  //! lookup tab button array pos (-1 if none)
+  int lookupTabPos(int index) const;
+
+  //! mark tab index lookup for buttons at or after array pos as stale
+  void updateTabPositions(int pos);
+
+  //! update stale tab index lookup
+  void flushTabPositions() const;
+
+  //! update tab sizes and redraw (deferred inside beginUpdate/endUpdate)
+  void layoutTabs();
+
+  //! update tab sizes deferred by current beginUpdate/endUpdate (for position queries)
+  void flushLayout() const;
+
+  //! get scroll offset (pixels)
+  int scrollOffset() const;
+
+  //! get visible tab number at unscrolled position
+  int visibleTabAt(int x) const;
+
+  //! get tab rectangle (scrolled)
+  QRect tabRect(const CQTabBarButton *button) const;
+
+  //! get scroll position being scrolled to
+  int scrollTarget() const;
+
+  //! set scroll position (pixels)
+  void setScrollPos(int pos);
+
+  //! smooth scroll to position (pixels)
+  void scrollTo(int pos, int duration=SCROLL_TIME);
+
+  //! is scrolling (animating, dragging or recently scrolled)
+  bool isScrolling() const;
+
   //! handle paint event
   void paintEvent(QPaintEvent *);
 
+  //! draw tabs in region
+  void drawTabs(QPainter *painter, const QRegion &region, int xo);
+
+  //! render tab strip around scroll position
+  void updateStrip();
+
+  //! invalidate rendered tab strip
+  void invalidateStrip();
+
+  //! draw tab shape and label
+  void drawTab(QPainter *painter, const CQTabBarButton *button, const QStyleOptionTab &tabStyle);
+
+  //! draw tab badge/count and progress
+  void drawTabStatus(QPainter *painter, const CQTabBarButton *button, const QRect &r);
+
+  //! draw tab from rendered tab cache
+  void drawCachedTab(QPainter *painter, const CQTabBarButton *button,
+                     const QStyleOptionTab &tabStyle);
+
   //! handle resize event
   void resizeEvent(QResizeEvent *);
 
@@ -163,20 +266,38 @@ class CQTabBar : public QWidget {
   //! handle mouse release event
   void mouseReleaseEvent(QMouseEvent *);
 
+  //! handle mouse leave event
+  void leaveEvent(QEvent *);
+
+  //! handle mouse wheel event
+  void wheelEvent(QWheelEvent *);
+
   //! handle drag enter
   void dragEnterEvent(QDragEnterEvent *event);
 
   //! handle drag move
   void dragMoveEvent(QDragMoveEvent *event);
 
+  //! handle drag leave
+  void dragLeaveEvent(QDragLeaveEvent *event);
+
   //! handle drop
   void dropEvent(QDropEvent *event);
 
-  //! check if drag valid
-  bool dragValid(const QMimeData *m, QString &type, int &tabNum) const;
+  //! check if drag valid (source tab bar is null for drags from other processes)
+  bool dragValid(const QMimeData *m, CQTabBar *&bar, QString &name, int &tabNum) const;
+
+  //! drag insertion position valid
+  bool dragPosValid(CQTabBar *bar, int fromIndex, int k) const;
+
+  //! get visible tab insertion position at point
+  int dropPosAt(const QPoint &point) const;
 
-  //! drag pos valid
-  bool dragPosValid(const QString &type, const QPoint &pos) const;
+  //! set drop insertion position
+  void setDropPos(int k);
+
+  //! get drop insertion marker rectangle
+  QRect dropMarkerRect(int k) const;
 
   //! handle context menu event
   void contextMenuEvent(QContextMenuEvent *e);
@@ -187,6 +308,9 @@ class CQTabBar : public QWidget {
   //! show scroll buttons
   void showScrollButtons(bool show);
 
+  //! enable scroll buttons for scroll position
+  void updateScrollButtons();
+
   //! get tab shape for current position
   QTabBar::Shape getTabShape() const;
 
@@ -196,6 +320,18 @@ class CQTabBar : public QWidget {
   //! set press state
   void setPressPoint(const QPoint &p);
 
+  //! set pressed tab
+  void setPressIndex(int ind);
+
+  //! set tab under mouse
+  void setMoveIndex(int ind);
+
+  //! redraw single tab
+  void updateTab(int ind);
+
+  //! queue redraw of tab status
+  void updateTabStatus(int ind);
+
  signals:
   //! signal that the current tab has changed
   void currentChanged(int index);
@@ -209,11 +345,11 @@ class CQTabBar : public QWidget {
   //! request context menu
   void showContextMenuSignal(const QPoint &p);
 
-  //! notify tab moved (same group)
-  void tabMoved(int, int);
+  //! notify tab moved to new tab position (same group)
+  void tabMoved(int index, int pos);
 
-  //! request page move (to another palette group)
-  void tabMovePageSignal(const QString &, int, const QString &, int);
+  //! request page move from another tab bar in this process (to tab position)
+  void tabMovePage(CQTabBar *fromBar, int fromIndex, int toPos);
 
  private slots:
   //! handle left/bottom scroll button press
@@ -221,24 +357,64 @@ class CQTabBar : public QWidget {
   //! handle right/top scroll button press
   void rscrollSlot();
 
+  //! handle overflow button press
+  void menuSlot();
+
+  //! handle tab status redraw timer
+  void statusSlot();
+
+  //! handle scroll animation step
+  void scrollAnimSlot(const QVariant &value);
+  //! handle end of scrolling
+  void scrollIdleSlot();
+
  private:
-  typedef std::vector<CQTabBarButton *> TabButtons;
+  friend class CQTabBarMenu;
 
-  TabButtons            buttons_;      //! tab page buttons
-  int                   currentIndex_; //! current tab index (-1 if none)
-  Position              position_;     //! tab position (relative to contents)
-  bool                  allowNoTab_;   //! allow no current tab
-  Qt::ToolButtonStyle   buttonStyle_;  //! tab button style (text and/or icon)
-  CQTabBarScrollButton *lscroll_;      //! left/bottom scroll button if clipped
-  CQTabBarScrollButton *rscroll_;      //! right/top scroll button if clipped
-  QSize                 iconSize_;     //! icon size
-  mutable int           iw_, w_, h_;   //! tab bar icon width, width and height
-  mutable int           clipNum_;      //! first item clipped (-1 if none)
-  mutable int           offset_;       //! scroll offset
-  mutable bool          pressed_;      //! button pressed
-  mutable QPoint        pressPos_;     //! button press pos (for drag)
-  mutable int           pressIndex_;   //! tab at press position
-  mutable int           moveIndex_;    //! tab at current mouse position
+  typedef std::vector<CQTabBarButton *> TabButtons;
+  typedef QHash<int,int>                TabPositions;
+  typedef QHash<QWidget *,int>          WidgetTabs;
+  typedef QSet<int>                     TabIndices;
+
+  TabButtons            buttons_;            //! tab page buttons (dense, in tab order)
+  mutable TabPositions  tabPos_;             //! tab index to button array pos
+  mutable int           tabPosDirty_;        //! first stale button array pos (-1 if none)
+  WidgetTabs            widgetTabs_;         //! tab widget to tab index
+  int                   lastIndex_;          //! last allocated tab index
+  std::vector<int>      visibleTabs_;        //! button array pos of visible tabs
+  std::vector<int>      tabExtents_;         //! prefix sums of visible tab widths
+  int                   currentIndex_;       //! current tab index (-1 if none)
+  Position              position_;           //! tab position (relative to contents)
+  bool                  allowNoTab_;         //! allow no current tab
+  Qt::ToolButtonStyle   buttonStyle_;        //! tab button style (text and/or icon)
+  bool                  renderCache_;        //! cache rendered tabs
+  CQTabBarScrollButton *lscroll_;            //! left/bottom scroll button if clipped
+  CQTabBarScrollButton *rscroll_;            //! right/top scroll button if clipped
+  CQTabBarScrollButton *menuButton_;         //! overflow button if clipped
+  CQTabBarMenu         *menu_;               //! overflow tab list popup
+  QSize                 iconSize_;           //! icon size
+  mutable int           iw_, w_, h_;         //! tab bar icon width, width and height
+  int                   scrollPos_;          //! scroll position (pixels)
+  int                   maxScroll_;          //! max scroll position (0 if not clipped)
+  QVariantAnimation    *scrollAnim_;         //! smooth scroll animation
+  QTimer               *scrollIdleTimer_;    //! detect end of scrolling
+  QPixmap               strip_;              //! rendered tabs (used while scrolling)
+  bool                  stripValid_;         //! is rendered strip valid
+  int                   stripPos_;           //! strip start (unscrolled pixels)
+  int                   stripLen_;           //! strip length (pixels)
+  bool                  dragScroll_;         //! is drag scrolling
+  int                   dragScrollPos_;      //! last drag scroll mouse position
+  QElapsedTimer         dragScrollTime_;     //! time since last drag scroll move
+  double                dragScrollVelocity_; //! drag scroll velocity (pixels/ms)
+  int                   updateDepth_;        //! beginUpdate nesting depth
+  bool                  updatePending_;      //! layout needed at endUpdate
+  QTimer               *statusTimer_;        //! rate limit tab status redraws
+  TabIndices            statusTabs_;         //! tabs with changed status
+  mutable bool          pressed_;            //! button pressed
+  mutable QPoint        pressPos_;           //! button press pos (for drag)
+  mutable int           pressIndex_;         //! tab at press position
+  mutable int           moveIndex_;          //! tab at current mouse position
+  int                   dropPos_;            //! drop insertion position (-1 if none)
 };
 
 /*! base class for tab bar button
@@ -257,6 +433,9 @@ class CQTabBarButton {
   //! set text
   void setText(const QString &text);
 
+  //! get lowercase text (for filter)
+  const QString &lowerText() const { return lowerText_; }
+
   //! get icon
   const QIcon &icon() const { return icon_; }
   //! set icon
@@ -290,7 +469,25 @@ class CQTabBarButton {
   //! set pending
   void setPending(bool pending);
 
-  //! get bounding box
+  //! get badge text
+  const QString &badge() const { return badge_; }
+  //! set badge text
+  void setBadge(const QString &badge);
+
+  //! get count
+  int count() const { return count_; }
+  //! set count
+  void setCount(int count);
+
+  //! get progress (negative if none)
+  double progress() const { return progress_; }
+  //! set progress
+  void setProgress(double progress);
+
+  //! has badge, count or progress
+  bool hasStatus() const { return ! badge_.isEmpty() || count_ > 0 || progress_ >= 0.0; }
+
+  //! get bounding box (relative to unscrolled tab row)
   const QRect &rect() const { return r_; }
   //! set bounding box
   void setRect(const QRect &r);
@@ -298,22 +495,93 @@ class CQTabBarButton {
   //! get pixmap of icon
   QPixmap pixmap() const;
 
-  //! calc button width
+  //! get button width (cached)
   int width() const;
 
+  //! get label text prepared for drawing (cached)
+  const QStaticText &staticText() const;
+
+  //! invalidate cached button width and label text (text or font changed)
+  void invalidateWidth() { width_ = -1; staticTextValid_ = false; }
+
  private:
-  CQTabBar                   *bar_;          //! icon position
-  int                         index_;        //! index
-  QString                     text_;         //! text
-  QIcon                       icon_;         //! icon
-  QVariant                    data_;         //! data
-  mutable QIcon               positionIcon_; //! icon for position (cached)
-  mutable CQTabBar::Position  iconPosition_; //! position used for above (cached)
-  QString                     toolTip_;      //! tooltip
-  QWidget                    *w_;            //! associated widget
-  bool                        visible_;      //! is visible
-  bool                        pending_;      //! is pending
-  QRect                       r_;            //! bounding box
+  //! calc button width
+  int calcWidth() const;
+
+ private:
+  CQTabBar                   *bar_;             //! icon position
+  int                         index_;           //! index
+  QString                     text_;            //! text
+  QString                     lowerText_;       //! lowercase text
+  QIcon                       icon_;            //! icon
+  QVariant                    data_;            //! data
+  mutable QIcon               positionIcon_;    //! icon for position (cached)
+  mutable QString             positionIconKey_; //! shared pixmap cache key for above
+  QString                     toolTip_;         //! tooltip
+  QWidget                    *w_;               //! associated widget
+  bool                        visible_;         //! is visible
+  bool                        pending_;         //! is pending
+  QString                     badge_;           //! badge text
+  int                         count_;           //! count (0 if none)
+  double                      progress_;        //! progress (negative if none)
+  QRect                       r_;               //! bounding box
+  mutable int                 width_;           //! button width (cached, -1 if invalid)
+  mutable QStaticText         staticText_;      //! label text prepared for font (cached)
+  mutable bool                staticTextValid_; //! is label text valid
+};
+
+/*! internal class for tab bar overflow popup (filterable list of tabs)
+*/
+class CQTabBarMenu : public QFrame {
+  Q_OBJECT
+
+ public:
+  CQTabBarMenu(CQTabBar *bar);
+
+  //! prepare list for popup (rebuild if invalid, clear filter, select current tab)
+  void updateItems();
+
+  //! mark list for rebuild (tabs added, removed, moved, shown or hidden)
+  void invalidateItems();
+
+  //! update text and icon of tab's item
+  void updateItem(int ind);
+
+ private:
+  //! rebuild list from visible tabs
+  void rebuildItems();
+
+  //! forward navigation keys from filter to list
+  bool eventFilter(QObject *obj, QEvent *e);
+
+ private slots:
+  //! handle filter text change
+  void filterSlot(const QString &text);
+  //! handle return in filter
+  void activateSlot();
+  //! handle item selection
+  void itemSlot(QListWidgetItem *item);
+
+ private:
+  struct Row {
+    int     index; //! tab index
+    QString text;  //! lowercase tab text
+
+    Row(int index1, const QString &text1) : index(index1), text(text1) { }
+  };
+
+  typedef std::vector<Row> Rows;
+  typedef std::vector<int> RowNums;
+  typedef QHash<int,int>   IndexRows;
+
+  CQTabBar    *bar_;        //! parent tab bar
+  QLineEdit   *edit_;       //! filter edit
+  QListWidget *list_;       //! tab list
+  Rows         rows_;       //! tab index and lowercase text for each list row
+  IndexRows    indexRows_;  //! list row for tab index
+  RowNums      matches_;    //! rows matching current filter
+  QString      filter_;     //! current (lowercase) filter
+  bool         itemsValid_; //! list matches visible tabs
 };
 
 /*! internal class for tab bar scroll button
@@ -20,7 +20,10 @@
 #include <QKeyEvent>
 #include <QMenu>
 #include <QTimer>
+#include <QDateTime>
+#include <QElapsedTimer>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
@@ -39,7 +42,8 @@ namespace Constants {
 
 CQPaletteAreaMgr::
 CQPaletteAreaMgr(QMainWindow *window) :
- window_(window)
+ window_(window), hibernate_(false), hibernateTime_(10*60*1000), hibernateBudget_(0),
+ workBudget_(8)
 {
   setObjectName("mgr");
 
@@ -57,6 +61,17 @@ CQPaletteAreaMgr(QMainWindow *window) :
   rubberBand_ = new CQRubberBand;
 
   rubberBand_->hide();
+
+  hibernateTimer_ = new QTimer(this);
+
+  connect(hibernateTimer_, SIGNAL(timeout()), this, SLOT(hibernateSlot()));
+
+  // zero time timer so work runs when event loop is idle
+  workTimer_ = new QTimer(this);
+
+  workTimer_->setSingleShot(true);
+
+  connect(workTimer_, SIGNAL(timeout()), this, SLOT(workSlot()));
 }
 
 CQPaletteAreaMgr::
@@ -69,6 +84,12 @@ CQPaletteAreaMgr::
       delete *pa;
   }
 
+  for (WorkItems::iterator p = work_.begin(); p != work_.end(); ++p)
+    delete (*p).item;
+
+  for (WorkItems::iterator p = runWork_.begin(); p != runWork_.end(); ++p)
+    delete (*p).item;
+
   delete rubberBand_;
 }
 
@@ -148,6 +169,249 @@ addPage(CQPaletteAreaPage *page, Qt::DockWidgetArea dockArea)
   area->addPage(page);
 }
 
+// remember factory page for hibernation (called when added to a group)
+void
+CQPaletteAreaMgr::
+addFactoryPage(CQPaletteAreaPage *page)
+{
+  CQPaletteAreaFactoryPage *factoryPage = qobject_cast<CQPaletteAreaFactoryPage *>(page);
+
+  if (factoryPage && std::find(factoryPages_.begin(), factoryPages_.end(), factoryPage) ==
+                       factoryPages_.end())
+    factoryPages_.push_back(factoryPage);
+}
+
+// forget factory page removed by application (widget is no longer ours to hibernate)
+void
+CQPaletteAreaMgr::
+removeFactoryPage(CQPaletteAreaPage *page)
+{
+  FactoryPages::iterator p =
+    std::find(factoryPages_.begin(), factoryPages_.end(), page);
+
+  if (p != factoryPages_.end())
+    factoryPages_.erase(p);
+}
+
+// enable/disable hibernation of unused factory page widgets
+void
+CQPaletteAreaMgr::
+setHibernate(bool hibernate)
+{
+  hibernate_ = hibernate;
+
+  updateHibernateTimer();
+}
+
+// set time (msecs) after which unused factory page widgets are hibernated
+void
+CQPaletteAreaMgr::
+setHibernateTime(int t)
+{
+  hibernateTime_ = t;
+
+  updateHibernateTimer();
+}
+
+// set memory budget (bytes) for all factory page widgets (0 for no budget)
+void
+CQPaletteAreaMgr::
+setHibernateBudget(qint64 budget)
+{
+  hibernateBudget_ = budget;
+
+  updateHibernateTimer();
+}
+
+bool
+CQPaletteAreaMgr::FactoryPageLastUsedCmp::
+operator()(const CQPaletteAreaFactoryPage *p1, const CQPaletteAreaFactoryPage *p2) const
+{
+  return p1->lastUsed() < p2->lastUsed();
+}
+
+void
+CQPaletteAreaMgr::
+updateHibernateTimer()
+{
+  if (hibernate_) {
+    // check a few times per hibernate time (at most every 30 seconds)
+    hibernateTimer_->start(qBound(1000, hibernateTime_/4, 30000));
+  }
+  else
+    hibernateTimer_->stop();
+}
+
+// hibernate factory pages unused for longer than hibernate time, or least recently
+// used pages until under memory budget
+void
+CQPaletteAreaMgr::
+hibernateSlot()
+{
+  qint64 t = QDateTime::currentMSecsSinceEpoch();
+
+  FactoryPageArray pages;
+
+  qint64 cost = 0;
+
+  FactoryPages::iterator p1 = factoryPages_.begin();
+
+  for (FactoryPages::iterator p = factoryPages_.begin(); p != factoryPages_.end(); ++p) {
+    CQPaletteAreaFactoryPage *page = *p;
+
+    // compact deleted pages
+    if (! page) continue;
+
+    *p1++ = *p;
+
+    if (! page->isRealized() || ! page->group())
+      continue;
+
+    cost += page->memoryCost();
+
+    // widgets in use are touched so their unused time starts when they stop being current
+    if (page->isActive())
+      page->touch();
+    else
+      pages.push_back(page);
+  }
+
+  factoryPages_.erase(p1, factoryPages_.end());
+
+  // least recently used first
+  std::sort(pages.begin(), pages.end(), FactoryPageLastUsedCmp());
+
+  for (FactoryPageArray::iterator p = pages.begin(); p != pages.end(); ++p) {
+    CQPaletteAreaFactoryPage *page = *p;
+
+    bool expired    = (t - page->lastUsed() >= hibernateTime_);
+    bool overBudget = (hibernateBudget_ > 0 && cost > hibernateBudget_);
+
+    if (! expired && ! overBudget)
+      break;
+
+    cost -= page->memoryCost();
+
+    page->hibernate();
+  }
+}
+
+void
+CQPaletteAreaMgr::
+addWork(CQPaletteAreaPage *page, CQPaletteAreaWorkItem *item)
+{
+  WorkItem work;
+
+  work.page     = page;
+  work.item     = item;
+  work.priority = 0;
+
+  work_.push_back(work);
+
+  if (! workTimer_->isActive())
+    workTimer_->start(0);
+}
+
+void
+CQPaletteAreaMgr::
+removeWork(CQPaletteAreaPage *page)
+{
+  WorkItems::iterator p1 = work_.begin();
+
+  for (WorkItems::iterator p = work_.begin(); p != work_.end(); ++p) {
+    if ((*p).page == page) {
+      delete (*p).item;
+      continue;
+    }
+
+    *p1++ = *p;
+  }
+
+  work_.erase(p1, work_.end());
+
+  // items being run are detached from page and deleted by workSlot
+  // (one may be executing now)
+  for (WorkItems::iterator p = runWork_.begin(); p != runWork_.end(); ++p) {
+    if ((*p).page == page)
+      (*p).page = 0;
+  }
+}
+
+void
+CQPaletteAreaMgr::
+workSlot()
+{
+  QElapsedTimer timer;
+
+  timer.start();
+
+  // take queued items (items added while running are queued after these)
+  runWork_.swap(work_);
+
+  // order by page visibility: visible, collapsed (current page of collapsed window or area),
+  // then not current or hidden (stable so items for same visibility stay in order)
+  for (WorkItems::iterator p = runWork_.begin(); p != runWork_.end(); ++p) {
+    CQPaletteAreaPage *page = (*p).page;
+
+    if      (! page)
+      (*p).priority = 0; // discarded below
+    else if (page->visibility() == CQPaletteAreaPage::Visible)
+      (*p).priority = 0;
+    else if (page->visibility() == CQPaletteAreaPage::Collapsed)
+      (*p).priority = 1;
+    else
+      (*p).priority = 2;
+  }
+
+  std::stable_sort(runWork_.begin(), runWork_.end(), WorkItemPriorityCmp());
+
+  // run items (at least one so zero budget still makes progress), items
+  // which are done are deleted and cleared
+  uint i = 0, n = runWork_.size();
+
+  for ( ; i < n; ++i) {
+    if (i > 0 && timer.elapsed() >= workBudget_)
+      break;
+
+    // page deleted or work removed
+    if (! runWork_[i].page) continue;
+
+    bool more = runWork_[i].item->exec();
+
+    // (removeWork can be called from exec)
+    if (! more || ! runWork_[i].page) {
+      delete runWork_[i].item;
+
+      runWork_[i].item = 0;
+    }
+  }
+
+  // requeue unrun items, rerun items then new items (skipping deleted or removed)
+  WorkItems items;
+
+  items.swap(runWork_);
+
+  WorkItems newItems;
+
+  newItems.swap(work_);
+
+  for (uint j = 0; j < n; ++j) {
+    WorkItem &work = items[(i + j) % n];
+
+    if (! work.item) continue;
+
+    if (work.page)
+      work_.push_back(work);
+    else
+      delete work.item;
+  }
+
+  work_.insert(work_.end(), newItems.begin(), newItems.end());
+
+  if (! work_.empty())
+    workTimer_->start(0);
+}
+
 void
 CQPaletteAreaMgr::
 removePage(CQPaletteAreaPage *page)
@@ -159,6 +423,17 @@ removePage(CQPaletteAreaPage *page)
   assert(window);
 
   window->removePage(page);
+
+  // discard pending async load for removed page
+  CQPaletteAreaFactoryPage *factoryPage = qobject_cast<CQPaletteAreaFactoryPage *>(page);
+
+  if (factoryPage)
+    factoryPage->cancelLoad();
+
+  // discard idle work for removed page
+  removeWork(page);
+
+  removeFactoryPage(page);
 }
 
 void
@@ -486,12 +761,7 @@ addWindowAtPos(CQPaletteWindow *window, const QPoint &gpos)
       else if (y >= tol && y <= h - tol) {
         CQPaletteWindow *window1 = qobject_cast<CQPaletteWindow *>(widget);
 
-        int numPages = window->group()->numPages();
-
-        for (int j = 0; j < numPages; ++j)
-          window1->addPage(window->group()->getPage(j));
-
-        window1->setCurrentPage(window->group()->getPage(0));
+        window->group()->movePages(window->getPages(), window1->group());
 
         window->deleteLater();
 
@@ -517,10 +787,7 @@ addWindowAtPos(CQPaletteWindow *window, const QPoint &gpos)
       else if (x >= tol && x <= w - tol) {
         CQPaletteWindow *window1 = qobject_cast<CQPaletteWindow *>(widget);
 
-        int numPages = window->group()->numPages();
-
-        for (int j = 0; j < numPages; ++j)
-          window1->addPage(window->group()->getPage(j));
+        window->group()->movePages(window->getPages(), window1->group());
 
         window->deleteLater();
 
@@ -771,6 +1038,8 @@ expandSlot()
   updateTitle();
 
   updatePreviewState();
+
+  updatePageVisibility();
 }
 
 void
@@ -788,6 +1057,17 @@ collapseSlot()
   updateTitle();
 
   updatePreviewState();
+
+  updatePageVisibility();
+}
+
+// update visibility state of pages (area expanded/collapsed)
+void
+CQPaletteArea::
+updatePageVisibility()
+{
+  for (Windows::const_iterator p = windows_.begin(); p != windows_.end(); ++p)
+    (*p)->group()->updatePageVisibility();
 }
 
 void
@@ -947,11 +1227,9 @@ getPages() const
   Pages pages;
 
   for (Windows::const_iterator p = windows_.begin(); p != windows_.end(); ++p) {
-    CQPaletteWindow *window = *p;
-
-    CQPaletteWindow::Pages pages1 = window->getPages();
+    const CQPaletteWindow::Pages &pages1 = (*p)->pages();
 
-    std::copy(pages1.begin(), pages1.end(), std::back_inserter(pages));
+    pages.insert(pages.end(), pages1.begin(), pages1.end());
   }
 
   return pages;
@@ -1040,12 +1318,14 @@ calcAllowedAreas() const
 {
   Qt::DockWidgetAreas allowedAreas = Qt::AllDockWidgetAreas;
 
-  Pages pages = getPages();
+  for (Windows::const_iterator pw = windows_.begin(); pw != windows_.end(); ++pw) {
+    const CQPaletteWindow::Pages &pages = (*pw)->pages();
 
-  for (Pages::const_iterator p = pages.begin(); p != pages.end(); ++p) {
-    CQPaletteAreaPage *page = *p;
+    for (CQPaletteWindow::Pages::const_iterator p = pages.begin(); p != pages.end(); ++p) {
+      CQPaletteAreaPage *page = *p;
 
-    allowedAreas &= page->allowedAreas();
+      allowedAreas &= page->allowedAreas();
+    }
   }
 
   return allowedAreas;
@@ -1679,11 +1959,14 @@ hidePage(CQPaletteAreaPage *page)
 
 void
 CQPaletteWindow::
-movePage(CQPaletteAreaPage *page, CQPaletteWindow *newWindow)
+movePage(CQPaletteAreaPage *page, CQPaletteWindow *newWindow, int pos)
 {
   group_->removePage(page);
 
-  newWindow->group_->addPage(page);
+  if (pos >= 0)
+    newWindow->group_->insertPage(pos, page);
+  else
+    newWindow->group_->addPage(page);
 
   newWindow->group_->setCurrentPage(page);
 
@@ -1789,19 +2072,29 @@ pageChangedSlot(CQPaletteAreaPage *)
 {
   title_->update();
 
-  if (area_->isExpanded())
+  updateSizeConstraints();
+}
+
+void
+CQPaletteWindow::
+updateSizeConstraints()
+{
+  if (area_ && area_->isExpanded())
     area_->setSizeConstraints();
 }
 
+const CQPaletteWindow::Pages &
+CQPaletteWindow::
+pages() const
+{
+  return group()->pages();
+}
+
 CQPaletteWindow::Pages
 CQPaletteWindow::
 getPages() const
 {
-  CQPaletteGroup::PageArray pages;
-
-  group()->getPages(pages);
-
-  return pages;
+  return group()->pages();
 }
 
 uint
@@ -1864,7 +2157,7 @@ setFloated(bool floating, const QPoint &pos, bool dragAll)
     return;
 
   if (floating) {
-    CQPaletteGroup::PageArray pages = getPages();
+    const Pages &pages = this->pages();
 
     CQPaletteAreaPage *currentPage = this->currentPage();
 
@@ -1878,14 +2171,18 @@ setFloated(bool floating, const QPoint &pos, bool dragAll)
 
       parentPos_ = group_->currentIndex();
 
-      for (uint i = 0; i < pages.size(); ++i) {
-        if (pages[i] == currentPage) continue;
+      // moved pages must be copied as the group's page array changes during the move
+      CQPaletteGroup::PageArray movePages;
 
-        removePage(pages[i]);
+      movePages.reserve(pages.size() - 1);
 
-        newWindow_->addPage(pages[i]);
+      for (uint i = 0; i < pages.size(); ++i) {
+        if (pages[i] != currentPage)
+          movePages.push_back(pages[i]);
       }
 
+      group_->movePages(movePages, newWindow_->group());
+
       area_->updateSize();
 
       resize(saveSize);
@@ -1934,13 +2231,11 @@ cancelFloating()
     area_->updateSize();
   }
   else {
-    CQPaletteAreaPage *currentPage = this->currentPage();
-
-    removePage(currentPage);
+    CQPaletteGroup::PageArray pages;
 
-    newWindow_->insertPage(parentPos_, currentPage);
+    pages.push_back(this->currentPage());
 
-    newWindow_->setCurrentPage(currentPage);
+    group_->movePages(pages, newWindow_->group(), parentPos_);
 
     area_->removeWindow(this);
 
@@ -2061,9 +2356,9 @@ calcAllowedAreas() const
 {
   Qt::DockWidgetAreas allowedAreas = Qt::AllDockWidgetAreas;
 
-  CQPaletteGroup::PageArray pages = getPages();
+  const Pages &pages = this->pages();
 
-  for (CQPaletteGroup::PageArray::const_iterator p = pages.begin(); p != pages.end(); ++p) {
+  for (Pages::const_iterator p = pages.begin(); p != pages.end(); ++p) {
     CQPaletteAreaPage *page = *p;
 
     allowedAreas &= page->allowedAreas();
@@ -2072,6 +2367,50 @@ calcAllowedAreas() const
   return allowedAreas;
 }
 
+// update drag allowed areas and move page from docked area it is no longer allowed in
+void
+CQPaletteWindow::
+updatePageAllowedAreas(CQPaletteAreaPage *page)
+{
+  if (area_ && area_->isFloating())
+    area_->allowedAreas_ = area_->calcAllowedAreas();
+
+  // floating window allowed areas are those of its current page (see setFloated)
+  if (isFloating()) {
+    if (page == currentPage())
+      allowedAreas_ = page->allowedAreas();
+
+    return;
+  }
+
+  if (! area_ || isDetachedNoArea() || (page->allowedAreas() & dockArea()))
+    return;
+
+  Qt::DockWidgetArea dockAreas[] = {
+    Qt::LeftDockWidgetArea, Qt::RightDockWidgetArea,
+    Qt::TopDockWidgetArea , Qt::BottomDockWidgetArea
+  };
+
+  for (int i = 0; i < 4; ++i) {
+    if (! (page->allowedAreas() & dockAreas[i]))
+      continue;
+
+    CQPaletteArea *area = mgr_->getArea(dockAreas[i]);
+
+    // keep hidden page hidden in new area
+    bool hidden = page->hidden();
+
+    removePage(page);
+
+    area->addPage(page, ! hidden);
+
+    if (hidden)
+      page->group()->window()->hidePage(page);
+
+    break;
+  }
+}
+
 void
 CQPaletteWindow::
 dockAt(Qt::DockWidgetArea dockArea)
@@ -2166,6 +2505,8 @@ expandSlot()
   expanded_ = true;
 
   updateTitle();
+
+  group_->updatePageVisibility();
 }
 
 void
@@ -2182,6 +2523,8 @@ collapseSlot()
     setFixedHeight(dockHeight());
 
   updateTitle();
+
+  group_->updatePageVisibility();
 }
 
 void
@@ -2245,9 +2588,7 @@ void
 CQPaletteWindow::
 splitSlot()
 {
-  CQPaletteGroup::PageArray pages = getPages();
-
-  if (pages.size() == 1) return;
+  if (numPages() == 1) return;
 
   CQPaletteAreaPage *page = this->currentPage();
 
@@ -2283,15 +2624,11 @@ joinSlot()
 
   CQPaletteGroup::PageArray pages = getPages();
 
-  for (uint i = 0; i < pages.size(); ++i) {
-    CQPaletteAreaPage *page = pages[i];
+  // last joined page is made current
+  if (! pages.empty())
+    group_->movePages(pages, joinWindow->group(), -1, pages.back());
 
-    removePage(page);
-
-    joinWindow->addPage(page);
-
-    joinWindow->setCurrentPage(page);
-  }
+  area_->removeWindow(this);
 
   this->deleteLater();
 }
@@ -2320,6 +2657,8 @@ CQPaletteWindow::
 updateTitle()
 {
   title_->updateState();
+
+  title_->update();
 }
 
 void
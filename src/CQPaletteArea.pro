@@ -6,7 +6,7 @@ DEPENDPATH += .
 
 MOC_DIR = .moc
 
-QT += widgets
+QT += widgets concurrent
 
 CONFIG += staticlib
 
@@ -2,6 +2,14 @@
 #include <CQPaletteArea.h>
 #include <CQWidgetUtil.h>
 #include <QVariant>
+#include <QDateTime>
+#include <QChildEvent>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QtConcurrentRun>
+#include <algorithm>
 #include <cassert>
 
 CQPaletteGroupMgr *
@@ -25,51 +33,7 @@ CQPaletteGroup *
 CQPaletteGroupMgr::
 createGroup(CQPaletteWindow *window)
 {
-  CQPaletteGroup *group = new CQPaletteGroup(window);
-
-  groups_.push_back(group);
-
-  return group;
-}
-
-void
-CQPaletteGroupMgr::
-removeGroup(CQPaletteGroup *group)
-{
-  uint i = 0;
-
-  for ( ; i < groups_.size(); ++i)
-    if (groups_[i] == group)
-      break;
-
-  assert(i < groups_.size());
-
-  for ( ; i < groups_.size(); ++i)
-    groups_[i] = groups_[i + 1];
-
-  groups_.pop_back();
-}
-
-CQPaletteGroup *
-CQPaletteGroupMgr::
-getGroup(const QString &name) const
-{
-  for (uint i = 0; i < groups_.size(); ++i)
-    if (groups_[i]->objectName() == name)
-      return groups_[i];
-
-  return 0;
-}
-
-CQPaletteGroup *
-CQPaletteGroupMgr::
-getGroupFromTabBar(const QString &name) const
-{
-  for (uint i = 0; i < groups_.size(); ++i)
-    if (groups_[i]->tabbar()->objectName() == name)
-      return groups_[i];
-
-  return 0;
+  return new CQPaletteGroup(window);
 }
 
 //-------
@@ -87,9 +51,10 @@ CQPaletteGroup(CQPaletteWindow *window) :
 
   connect(tabbar_, SIGNAL(currentChanged(int)), this, SLOT(setTabIndex(int)));
   connect(tabbar_, SIGNAL(currentPressed(int)), this, SLOT(pressTabIndex(int)));
+  connect(tabbar_, SIGNAL(tabMoved(int, int)), this, SLOT(tabMovedSlot(int, int)));
 
-  connect(tabbar_, SIGNAL(tabMovePageSignal(const QString &, int, const QString &, int)),
-          this, SLOT(tabMovePageSlot(const QString &, int, const QString &, int)));
+  connect(tabbar_, SIGNAL(tabMovePage(CQTabBar *, int, int)),
+          this, SLOT(tabMovePageSlot(CQTabBar *, int, int)));
 
   updateLayout();
 }
@@ -97,7 +62,6 @@ CQPaletteGroup(CQPaletteWindow *window) :
 CQPaletteGroup::
 ~CQPaletteGroup()
 {
-  CQPaletteGroupMgrInst->removeGroup(this);
 }
 
 Qt::DockWidgetArea
@@ -133,8 +97,11 @@ addPage(CQPaletteAreaPage *page)
 
   page->setHidden(false);
 
-  tabbar_->addPage(page);
-  stack_ ->addPage(page);
+  addTabPage(-1, page);
+
+  trackPage(page);
+
+  updatePageVisibility();
 }
 
 void
@@ -147,8 +114,13 @@ insertPage(int ind, CQPaletteAreaPage *page)
 
   pages_[page->id()] = page;
 
-  tabbar_->insertPage(ind, page);
-  stack_ ->addPage   (page);
+  page->setHidden(false);
+
+  addTabPage(ind, page);
+
+  trackPage(page);
+
+  updatePageVisibility();
 }
 
 void
@@ -157,15 +129,98 @@ removePage(CQPaletteAreaPage *page)
 {
   page->setGroup(0);
 
-  page->setHidden(true);
+  if (! page->hidden())
+    removeTabPage(page);
 
-  tabbar_->removePage(page);
-  stack_ ->removePage(page);
+  page->setHidden(true);
 
   pages_.erase(page->id());
 
-  if (! pages_.empty())
-    setCurrentPage(pages_.begin()->second);
+  if (! currentPage())
+    updateCurrentPage();
+
+  page->updateVisibility();
+
+  updatePageVisibility();
+}
+
+// register page with manager (factory pages are tracked for hibernation)
+void
+CQPaletteGroup::
+trackPage(CQPaletteAreaPage *page)
+{
+  CQPaletteArea *area = (window_ ? window_->area() : 0);
+
+  if (area)
+    area->mgr()->addFactoryPage(page);
+}
+
+// move pages to other group deferring tab layout, stack and current page updates
+// (and so area size constraints) until all pages are moved
+void
+CQPaletteGroup::
+movePages(const PageArray &pages, CQPaletteGroup *toGroup, int pos,
+          CQPaletteAreaPage *currentPage)
+{
+  if (pages.empty() || toGroup == this)
+    return;
+
+  CQPaletteAreaPage *oldCurrentPage = this->currentPage();
+
+  tabbar_         ->beginUpdate();
+  toGroup->tabbar_->beginUpdate();
+
+  // current page changes are applied once below
+  tabbar_         ->blockSignals(true);
+  toGroup->tabbar_->blockSignals(true);
+
+  for (PageArray::const_iterator p = pages.begin(); p != pages.end(); ++p) {
+    CQPaletteAreaPage *page = *p;
+
+    assert(page->group() == this);
+
+    if (! page->hidden())
+      removeTabPage(page);
+
+    pages_.erase(page->id());
+
+    page->setGroup(toGroup);
+
+    page->setDockArea(toGroup->dockArea());
+
+    toGroup->pages_[page->id()] = page;
+
+    page->setHidden(false);
+
+    toGroup->addTabPage(pos, page, false);
+
+    toGroup->trackPage(page);
+
+    if (pos >= 0)
+      ++pos;
+  }
+
+  if (! currentPage)
+    currentPage = pages[0];
+
+  toGroup->tabbar_->setCurrentIndex(toGroup->getPageTab(currentPage));
+
+  if (! this->currentPage())
+    updateCurrentPage();
+
+  toGroup->tabbar_->blockSignals(false);
+  tabbar_         ->blockSignals(false);
+
+  toGroup->tabbar_->endUpdate();
+  tabbar_         ->endUpdate();
+
+  // update stacks and notify current page changes
+  if (this->currentPage() != oldCurrentPage)
+    setTabIndex(tabbar_->currentIndex());
+
+  toGroup->setTabIndex(toGroup->tabbar_->currentIndex());
+
+  updatePageVisibility();
 }
 
 void
@@ -177,11 +232,12 @@ showPage(CQPaletteAreaPage *page)
 
   page->setHidden(false);
 
-  tabbar_->addPage(page);
-  stack_ ->addPage(page);
+  addTabPage(-1, page);
 
   if (! currentPage())
     setCurrentPage(page);
+
+  updatePageVisibility();
 }
 
 void
@@ -191,15 +247,17 @@ hidePage(CQPaletteAreaPage *page)
   if (page->hidden())
     return;
 
-  bool current = (page == currentPage());
+  removeTabPage(page);
 
   page->setHidden(true);
 
-  tabbar_->removePage(page);
-  stack_ ->removePage(page);
-
-  if (current)
+  // tab bar selects neighbouring tab when current is removed
+  if (! currentPage())
     updateCurrentPage();
+
+  page->updateVisibility();
+
+  updatePageVisibility();
 }
 
 CQPaletteAreaPage *
@@ -221,74 +279,131 @@ currentIndex() const
   return tabbar_->currentIndex();
 }
 
+// add tab for visible page at tab position (-1 for end)
 void
 CQPaletteGroup::
-setCurrentPage(CQPaletteAreaPage *page)
+addTabPage(int ind, CQPaletteAreaPage *page, bool updateStack)
 {
-  for (int i = 0; i < tabbar_->count(); ++i) {
-    uint ind = tabbar_->tabInd(i);
+  int pos = (ind >= 0 ? std::min(ind, int(tabPages_.size())) : int(tabPages_.size()));
 
-    uint id = tabbar_->getPageId(ind);
+  tabPages_.insert(tabPages_.begin() + pos, page);
 
-    if (id == page->id()) {
-      tabbar_->setCurrentIndex(ind);
+  int tabInd = tabbar_->insertPage(pos, page);
 
-      return;
-    }
-  }
+  pageTabs_[page->id()] = tabInd;
+
+  stack_->addPage(page);
+
+  // tab bar makes first tab current before page is known so update stack now
+  if (updateStack && tabbar_->currentIndex() == tabInd)
+    stack_->setPage(page);
 }
 
+// remove tab for visible page
 void
 CQPaletteGroup::
-updateCurrentPage()
+removeTabPage(CQPaletteAreaPage *page)
 {
-  for (Pages::const_iterator p = pages_.begin(); p != pages_.end(); ++p) {
-    CQPaletteAreaPage *page = (*p).second;
+  PageArray::iterator p = std::find(tabPages_.begin(), tabPages_.end(), page);
 
-    if (! page->hidden()) {
-      setCurrentPage(page);
-      return;
-    }
+  assert(p != tabPages_.end());
+
+  tabPages_.erase(p);
+
+  tabbar_->removePage(page);
+  stack_ ->removePage(page);
+
+  pageTabs_.remove(page->id());
+}
+
+// update tab (and window title if current) for changed page title/icon
+void
+CQPaletteGroup::
+updatePageTitle(CQPaletteAreaPage *page)
+{
+  int ind = getPageTab(page);
+
+  if (ind >= 0) {
+    tabbar_->beginUpdate();
+
+    tabbar_->setTabText(ind, page->title());
+    tabbar_->setTabIcon(ind, page->icon());
+
+    tabbar_->endUpdate();
   }
+
+  if (page == currentPage() && window_)
+    window_->updateTitle();
 }
 
-CQPaletteAreaPage *
+// update window for changed page allowed areas
+void
 CQPaletteGroup::
-getPage(int i) const
+updatePageAllowedAreas(CQPaletteAreaPage *page)
+{
+  if (window_)
+    window_->updatePageAllowedAreas(page);
+}
+
+// update window size constraints for changed page min/max size (only current page is shown)
+void
+CQPaletteGroup::
+updatePageSize(CQPaletteAreaPage *page)
+{
+  if (page == currentPage() && window_)
+    window_->updateSizeConstraints();
+}
+
+// get tab index for page (-1 if hidden or not in group)
+int
+CQPaletteGroup::
+getPageTab(CQPaletteAreaPage *page) const
 {
-  PageArray pages;
+  PageTabs::const_iterator p = pageTabs_.find(page->id());
 
-  getPages(pages);
+  if (p == pageTabs_.end())
+    return -1;
 
-  return pages[i];
+  return p.value();
 }
 
-uint
+void
 CQPaletteGroup::
-numPages() const
+setCurrentPage(CQPaletteAreaPage *page)
 {
-  int num = 0;
+  int ind = getPageTab(page);
 
-  for (Pages::const_iterator p = pages_.begin(); p != pages_.end(); ++p) {
-    CQPaletteAreaPage *page = (*p).second;
+  if (ind >= 0)
+    tabbar_->setCurrentIndex(ind);
+}
 
-    if (! page->hidden())
-      ++num;
-  }
+void
+CQPaletteGroup::
+updateCurrentPage()
+{
+  if (! tabPages_.empty())
+    setCurrentPage(tabPages_[0]);
+}
+
+CQPaletteAreaPage *
+CQPaletteGroup::
+getPage(int i) const
+{
+  return tabPages_[i];
+}
 
-  return num;
+uint
+CQPaletteGroup::
+numPages() const
+{
+  return tabPages_.size();
 }
 
 void
 CQPaletteGroup::
 getPages(PageArray &pages) const
 {
-  for (Pages::const_iterator p = pages_.begin(); p != pages_.end(); ++p) {
-    CQPaletteAreaPage *page = (*p).second;
-
-    if (! page->hidden())
-      pages.push_back(page);
-  }
+  pages.insert(pages.end(), tabPages_.begin(), tabPages_.end());
 }
 
 void
@@ -304,6 +419,54 @@ setTabIndex(int ind)
 
   if (! window()->area()->isExpanded())
     window()->area()->expandSlot();
+
+  updatePageVisibility();
+}
+
+// update visibility state of visible pages (current page changed, area expanded/collapsed)
+void
+CQPaletteGroup::
+updatePageVisibility()
+{
+  for (PageArray::const_iterator p = tabPages_.begin(); p != tabPages_.end(); ++p)
+    (*p)->updateVisibility();
+}
+
+// is group window or area collapsed (only tabbar can be seen)
+bool
+CQPaletteGroup::
+isCollapsed() const
+{
+  CQPaletteArea *area = (window_ ? window_->area() : 0);
+
+  return ((window_ && ! window_->isExpanded()) || (area && ! area->isExpanded()));
+}
+
+void
+CQPaletteGroup::
+updatePageStatus(CQPaletteAreaPage *page)
+{
+  int ind = getPageTab(page);
+
+  if (ind >= 0)
+    tabbar_->updatePageStatus(ind, page);
+}
+
+// keep tab ordered pages in sync with tab moved in tab bar
+void
+CQPaletteGroup::
+tabMovedSlot(int ind, int pos)
+{
+  CQPaletteAreaPage *page = getPageForIndex(ind);
+  if (! page) return;
+
+  PageArray::iterator p = std::find(tabPages_.begin(), tabPages_.end(), page);
+
+  assert(p != tabPages_.end());
+
+  tabPages_.erase(p);
+
+  tabPages_.insert(tabPages_.begin() + std::min(pos, int(tabPages_.size())), page);
 }
 
 void
@@ -315,18 +478,19 @@ pressTabIndex(int /*ind*/)
 
 void
 CQPaletteGroup::
-tabMovePageSlot(const QString &fromName, int fromIndex, const QString &toName, int /*toIndex*/)
+tabMovePageSlot(CQTabBar *fromBar, int fromIndex, int toPos)
 {
-  CQPaletteGroup *group1 = CQPaletteGroupMgrInst->getGroupFromTabBar(fromName);
-  CQPaletteGroup *group2 = CQPaletteGroupMgrInst->getGroupFromTabBar(toName);
+  // source group from typed tab bar (in-process drag)
+  CQPaletteGroupTabBar *tabbar1 = qobject_cast<CQPaletteGroupTabBar *>(fromBar);
+  if (! tabbar1) return;
 
-  assert(group2 == this);
+  CQPaletteGroup *group1 = tabbar1->group();
 
   CQPaletteAreaPage *page1 = group1->getPageForIndex(fromIndex);
-//CQPaletteAreaPage *page2 = group2->getPageForIndex(toIndex);
+  if (! page1) return;
 
-  if (page1->allowedAreas() & group2->window()->dockArea())
-    group1->window()->movePage(page1, group2->window());
+  if (page1->allowedAreas() & window()->dockArea())
+    group1->window()->movePage(page1, window(), toPos);
 }
 
 CQPaletteAreaPage *
@@ -424,7 +588,7 @@ sizeHint() const
 
 CQPaletteGroupTabBar::
 CQPaletteGroupTabBar(CQPaletteGroup *group) :
- CQTabBar(group), group_(group)
+ CQTabBar(group), group_(group), thumbnailTip_(0)
 {
   setObjectName("tabbar");
 
@@ -462,42 +626,47 @@ updateDockArea()
 #endif
 }
 
-void
+int
 CQPaletteGroupTabBar::
 addPage(CQPaletteAreaPage *page)
 {
-  int ind = addTab(page->icon(), page->title());
-
-  setTabData(ind, page->id());
+  return insertPage(count(), page);
 }
 
-void
+int
 CQPaletteGroupTabBar::
 insertPage(int ind, CQPaletteAreaPage *page)
 {
   int ind1 = insertTab(ind, page->icon(), page->title());
 
   setTabData(ind1, page->id());
+
+  updatePageStatus(ind1, page);
+
+  return ind1;
 }
 
 void
 CQPaletteGroupTabBar::
 removePage(CQPaletteAreaPage *page)
 {
-  int i = 0, ind = -1;
-
-  for ( ; i < count(); ++i) {
-    ind = tabInd(i);
+  int ind = group_->getPageTab(page);
 
-    if (getPageId(ind) == page->id())
-      break;
-  }
-
-  assert(i < count());
+  assert(ind >= 0);
 
   removeTab(ind);
 }
 
+// update tab badge, count and progress from page
+void
+CQPaletteGroupTabBar::
+updatePageStatus(int ind, CQPaletteAreaPage *page)
+{
+  setTabBadge   (ind, page->badge());
+  setTabCount   (ind, page->count());
+  setTabProgress(ind, page->progress());
+}
+
 uint
 CQPaletteGroupTabBar::
 getPageId(int ind) const
@@ -505,6 +674,35 @@ getPageId(int ind) const
   return tabData(ind).toUInt();
 }
 
+// show page thumbnail for tab of collapsed group (contents can't be seen)
+bool
+CQPaletteGroupTabBar::
+showTabToolTip(int ind, const QPoint &gpos)
+{
+  if (! group_->isCollapsed())
+    return false;
+
+  CQPaletteAreaPage *page = group_->getPageForIndex(ind);
+
+  if (! page || page->thumbnail().isNull())
+    return false;
+
+  if (! thumbnailTip_)
+    thumbnailTip_ = new CQPaletteGroupThumbnailTip(this);
+
+  thumbnailTip_->showPage(page, gpos);
+
+  return true;
+}
+
+void
+CQPaletteGroupTabBar::
+hideTabToolTip()
+{
+  if (thumbnailTip_)
+    thumbnailTip_->hide();
+}
+
 QSize
 CQPaletteGroupTabBar::
 sizeHint() const
@@ -544,7 +742,7 @@ minimumSizeHint() const
 
 CQPaletteGroupStack::
 CQPaletteGroupStack(QWidget *parent) :
- QStackedWidget(parent)
+ QWidget(parent), current_(0)
 {
   setObjectName("stack");
 }
@@ -552,8 +750,9 @@ CQPaletteGroupStack(QWidget *parent) :
 CQPaletteGroupStack::
 ~CQPaletteGroupStack()
 {
-  while (count())
-    removeWidget(widget(0));
+  // page widgets are owned by pages
+  while (! widgets_.empty())
+    removeWidget(widgets_.back());
 }
 
 void
@@ -573,72 +772,779 @@ CQPaletteGroupStack::
 removePage(CQPaletteAreaPage *page)
 {
   removeWidget(page->widget());
-
-  page->widget()->setParent(0);
 }
 
+// add page widget (hidden until current)
 void
 CQPaletteGroupStack::
-setPage(CQPaletteAreaPage *page)
+addWidget(QWidget *w)
 {
-  setCurrentWidget(page->widget());
-}
+  w->hide();
 
-//------
+  w->setParent(this);
 
-uint CQPaletteAreaPage::lastId_ = 0;
+  widgets_.push_back(w);
+}
 
-CQPaletteAreaPage::
-CQPaletteAreaPage(QWidget *w) :
- w_(w), dockArea_(Qt::NoDockWidgetArea), hidden_(false), fixedWidth_(100), fixedHeight_(100),
- widthResizable_(true), heightResizable_(true)
+// remove page widget (unparented)
+void
+CQPaletteGroupStack::
+removeWidget(QWidget *w)
 {
-  setObjectName("page");
+  Widgets::iterator p = std::find(widgets_.begin(), widgets_.end(), w);
 
-  id_ = ++lastId_;
+  if (p == widgets_.end())
+    return;
+
+  widgets_.erase(p);
+
+  if (w == current_)
+    current_ = 0;
+
+  w->hide();
+
+  w->setParent(0);
 }
 
+// set current page widget (only the current widget is shown and sized)
 void
-CQPaletteAreaPage::
-setWidget(QWidget *w)
+CQPaletteGroupStack::
+setCurrentWidget(QWidget *w)
 {
-  w_ = w;
+  if (w == current_)
+    return;
+
+  assert(std::find(widgets_.begin(), widgets_.end(), w) != widgets_.end());
+
+  QWidget *oldWidget = current_;
+
+  current_ = w;
+
+  // apply current geometry before showing (skipped while not current)
+  current_->setGeometry(rect());
+
+  current_->show();
+
+  if (oldWidget)
+    oldWidget->hide();
+
+  updateGeometry();
 }
 
-// get page min/max width
 void
-CQPaletteAreaPage::
-getMinMaxWidth(int &min_w, int &max_w) const
+CQPaletteGroupStack::
+setPage(CQPaletteAreaPage *page)
 {
-  if (widthResizable()) {
-    QWidget *w = const_cast<CQPaletteAreaPage *>(this)->widget();
+  // build factory page widget on first use (replaces placeholder)
+  CQPaletteAreaFactoryPage *factoryPage = qobject_cast<CQPaletteAreaFactoryPage *>(page);
 
-    QSize s = CQWidgetUtil::SmartMinSize(w);
+  if (factoryPage && ! factoryPage->isRealized()) {
+    QWidget *placeholder = page->widget();
 
-    min_w = s.width();
-    max_w = w->maximumWidth();
-  }
-  else {
-    min_w = fixedWidth_;
-    max_w = min_w;
+    factoryPage->realize();
+
+    // not realized if waiting for async data (placeholder shown until loaded)
+    if (factoryPage->isRealized()) {
+      replaceWidget(placeholder, page->widget());
+
+      placeholder->deleteLater();
+    }
   }
+
+  setCurrentWidget(page->widget());
 }
 
-// get page min/max height
+// replace page widget in stack (keeping current state)
 void
-CQPaletteAreaPage::
-getMinMaxHeight(int &min_h, int &max_h) const
+CQPaletteGroupStack::
+replaceWidget(QWidget *oldWidget, QWidget *newWidget)
 {
-  if (heightResizable()) {
-    QWidget *w = const_cast<CQPaletteAreaPage *>(this)->widget();
+  Widgets::iterator p = std::find(widgets_.begin(), widgets_.end(), oldWidget);
+  assert(p != widgets_.end());
 
-    QSize s = CQWidgetUtil::SmartMinSize(w);
+  bool current = (oldWidget == current_);
 
-    min_h = s.height();
-    max_h = w->maximumHeight();
-  }
-  else {
-    min_h = fixedHeight_;
-    max_h = min_h;
-  }
+  newWidget->hide();
+
+  newWidget->setParent(this);
+
+  *p = newWidget;
+
+  oldWidget->hide();
+
+  oldWidget->setParent(0);
+
+  if (current) {
+    current_ = newWidget;
+
+    current_->setGeometry(rect());
+
+    current_->show();
+
+    updateGeometry();
+  }
+}
+
+// pass page widget size changes up (no layout to do it for us)
+bool
+CQPaletteGroupStack::
+event(QEvent *e)
+{
+  if (e->type() == QEvent::LayoutRequest) {
+    // current page widget min/max size changed
+    CQPaletteGroup *group = qobject_cast<CQPaletteGroup *>(parentWidget());
+
+    CQPaletteAreaPage *page = (group ? group->currentPage() : 0);
+
+    if (page)
+      page->invalidateMinMax();
+
+    updateGeometry();
+  }
+
+  return QWidget::event(e);
+}
+
+// resize current page widget only (others are resized when they become current)
+void
+CQPaletteGroupStack::
+resizeEvent(QResizeEvent *)
+{
+  if (current_)
+    current_->setGeometry(rect());
+}
+
+// forget page widgets deleted while in stack
+void
+CQPaletteGroupStack::
+childEvent(QChildEvent *e)
+{
+  if (e->type() == QEvent::ChildRemoved) {
+    Widgets::iterator p = std::find(widgets_.begin(), widgets_.end(), e->child());
+
+    if (p != widgets_.end()) {
+      widgets_.erase(p);
+
+      if (e->child() == current_)
+        current_ = 0;
+    }
+  }
+
+  QWidget::childEvent(e);
+}
+
+QSize
+CQPaletteGroupStack::
+sizeHint() const
+{
+  return (current_ ? current_->sizeHint() : QSize());
+}
+
+QSize
+CQPaletteGroupStack::
+minimumSizeHint() const
+{
+  return (current_ ? current_->minimumSizeHint() : QSize());
+}
+
+//------
+
+CQPaletteGroupThumbnailTip::
+CQPaletteGroupThumbnailTip(QWidget *parent) :
+ QLabel(parent, Qt::ToolTip)
+{
+  setObjectName("thumbnailTip");
+
+  setFrameStyle(QFrame::Box | QFrame::Plain);
+  setMargin(2);
+
+  setForegroundRole(QPalette::ToolTipText);
+  setBackgroundRole(QPalette::ToolTipBase);
+
+  setAutoFillBackground(true);
+}
+
+void
+CQPaletteGroupThumbnailTip::
+showPage(CQPaletteAreaPage *page, const QPoint &gpos)
+{
+  setPixmap(QPixmap::fromImage(page->thumbnail()));
+
+  adjustSize();
+
+  // position below cursor (kept on screen)
+  QRect screenRect = QApplication::desktop()->availableGeometry(gpos);
+
+  QPoint pos = gpos + QPoint(2, 16);
+
+  if (pos.x() + width () > screenRect.right ()) pos.setX(screenRect.right () - width ());
+  if (pos.y() + height() > screenRect.bottom()) pos.setY(gpos.y() - height() - 4);
+
+  move(pos);
+
+  show();
+
+  raise();
+}
+
+//------
+
+uint CQPaletteAreaPage::lastId_ = 0;
+
+CQPaletteAreaPage::
+CQPaletteAreaPage(QWidget *w) :
+ group_(0), w_(w), dockArea_(Qt::NoDockWidgetArea), hidden_(false), fixedWidth_(100),
+ fixedHeight_(100), widthResizable_(true), heightResizable_(true),
+ allowedAreas_(Qt::AllDockWidgetAreas), count_(0), progress_(-1.0),
+ visibility_(Hidden), minMaxValid_(false), thumbnailDirty_(true), thumbnailWatcher_(0)
+{
+  setObjectName("page");
+
+  id_ = ++lastId_;
+
+  // track widget show/hide (stack page change, window or area shown/hidden)
+  if (w_)
+    w_->installEventFilter(this);
+}
+
+void
+CQPaletteAreaPage::
+setWidget(QWidget *w)
+{
+  if (w_)
+    w_->removeEventFilter(this);
+
+  w_ = w;
+
+  if (w_)
+    w_->installEventFilter(this);
+
+  invalidateMinMax();
+
+  updateVisibility();
+}
+
+void
+CQPaletteAreaPage::
+setWidthResizable(bool resizable)
+{
+  widthResizable_ = resizable;
+
+  invalidateMinMax();
+}
+
+void
+CQPaletteAreaPage::
+setHeightResizable(bool resizable)
+{
+  heightResizable_ = resizable;
+
+  invalidateMinMax();
+}
+
+void
+CQPaletteAreaPage::
+setFixedWidth(int width)
+{
+  fixedWidth_ = width;
+
+  setWidthResizable(false);
+}
+
+void
+CQPaletteAreaPage::
+setFixedHeight(int height)
+{
+  fixedHeight_ = height;
+
+  setHeightResizable(false);
+}
+
+// calc whether page contents can be seen
+CQPaletteAreaPage::Visibility
+CQPaletteAreaPage::
+calcVisibility() const
+{
+  if (hidden() || ! group_)
+    return Hidden;
+
+  if (group_->currentPage() != this)
+    return Inactive;
+
+  if (! w_ || ! w_->isVisible() || group_->isCollapsed())
+    return Collapsed;
+
+  return Visible;
+}
+
+// update visibility state and notify if changed
+void
+CQPaletteAreaPage::
+updateVisibility()
+{
+  Visibility visibility = calcVisibility();
+
+  if (visibility == visibility_)
+    return;
+
+  Visibility oldVisibility = visibility_;
+
+  visibility_ = visibility;
+
+  // keep thumbnail of contents for when they can't be seen
+  if (oldVisibility == Visible)
+    updateThumbnail();
+
+  visibilityEvent(visibility_);
+
+  emit visibilityChanged(visibility_);
+
+  if      (visibility_ == Visible)
+    emit pageShown();
+  else if (oldVisibility == Visible)
+    emit pageHidden();
+}
+
+// scale page contents image to thumbnail size (on thread pool thread)
+static QImage
+scaleThumbnail(const QImage &image)
+{
+  enum { THUMBNAIL_SIZE = 192 };
+
+  if (image.width() <= THUMBNAIL_SIZE && image.height() <= THUMBNAIL_SIZE)
+    return image;
+
+  return image.scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio,
+                      Qt::SmoothTransformation);
+}
+
+// grab page contents for thumbnail (if changed) and scale in background
+void
+CQPaletteAreaPage::
+updateThumbnail()
+{
+  if (! thumbnailDirty_ || ! w_ || w_->width() <= 1 || w_->height() <= 1)
+    return;
+
+  thumbnailDirty_ = false;
+
+  QImage image = w_->grab().toImage();
+
+  // discard any pending scale of older image
+  if (thumbnailWatcher_)
+    thumbnailWatcher_->deleteLater();
+
+  thumbnailWatcher_ = new ThumbnailWatcher(this);
+
+  connect(thumbnailWatcher_, SIGNAL(finished()), this, SLOT(thumbnailSlot()));
+
+  thumbnailWatcher_->setFuture(QtConcurrent::run(scaleThumbnail, image));
+}
+
+// thumbnail scaled (GUI thread)
+void
+CQPaletteAreaPage::
+thumbnailSlot()
+{
+  if (! thumbnailWatcher_ || sender() != thumbnailWatcher_)
+    return;
+
+  thumbnail_ = thumbnailWatcher_->result();
+
+  thumbnailWatcher_->deleteLater();
+
+  thumbnailWatcher_ = 0;
+}
+
+// check for page widget show/hide and layout change
+bool
+CQPaletteAreaPage::
+eventFilter(QObject *obj, QEvent *e)
+{
+  if (obj == w_) {
+    if      (e->type() == QEvent::Show || e->type() == QEvent::Hide)
+      updateVisibility();
+    else if (e->type() == QEvent::LayoutRequest)
+      invalidateMinMax();
+  }
+
+  return QObject::eventFilter(obj, e);
+}
+
+// set tab title
+void
+CQPaletteAreaPage::
+setTitle(const QString &title)
+{
+  if (title == title_)
+    return;
+
+  title_ = title;
+
+  if (group_)
+    group_->updatePageTitle(this);
+
+  emit titleChanged();
+}
+
+// set tab icon
+void
+CQPaletteAreaPage::
+setIcon(const QIcon &icon)
+{
+  if (icon.cacheKey() == icon_.cacheKey())
+    return;
+
+  icon_ = icon;
+
+  if (group_)
+    group_->updatePageTitle(this);
+
+  emit iconChanged();
+}
+
+// set allowed dock areas
+void
+CQPaletteAreaPage::
+setAllowedAreas(Qt::DockWidgetAreas areas)
+{
+  if (areas == allowedAreas_)
+    return;
+
+  allowedAreas_ = areas;
+
+  if (group_)
+    group_->updatePageAllowedAreas(this);
+
+  emit allowedAreasChanged();
+}
+
+// set badge text shown on page tab
+void
+CQPaletteAreaPage::
+setBadge(const QString &badge)
+{
+  badge_ = badge;
+
+  if (group_)
+    group_->updatePageStatus(this);
+}
+
+// set count shown on page tab (0 for none)
+void
+CQPaletteAreaPage::
+setCount(int count)
+{
+  count_ = count;
+
+  if (group_)
+    group_->updatePageStatus(this);
+}
+
+// set progress shown on page tab (0.0 to 1.0, negative for none)
+void
+CQPaletteAreaPage::
+setProgress(double progress)
+{
+  progress_ = progress;
+
+  if (group_)
+    group_->updatePageStatus(this);
+}
+
+// calc widget min/max size (if layout changed)
+void
+CQPaletteAreaPage::
+updateMinMax() const
+{
+  // explicit min/max size changes are posted to widget parent so check them here
+  if (minMaxValid_ && (! w_ || (w_->minimumSize() == widgetSetMinSize_ &&
+                                w_->maximumSize() == widgetMaxSize_)))
+    return;
+
+  if (w_) {
+    widgetMinSize_    = CQWidgetUtil::SmartMinSize(w_);
+    widgetMaxSize_    = w_->maximumSize();
+    widgetSetMinSize_ = w_->minimumSize();
+  }
+  else {
+    widgetMinSize_ = QSize(0, 0);
+    widgetMaxSize_ = QSize(QWIDGETSIZE_MAX, QWIDGETSIZE_MAX);
+  }
+
+  minMaxValid_ = true;
+}
+
+// get page min/max width
+void
+CQPaletteAreaPage::
+getMinMaxWidth(int &min_w, int &max_w) const
+{
+  if (widthResizable()) {
+    updateMinMax();
+
+    min_w = widgetMinSize_.width();
+    max_w = widgetMaxSize_.width();
+  }
+  else {
+    min_w = fixedWidth_;
+    max_w = min_w;
+  }
+}
+
+// get page min/max height
+void
+CQPaletteAreaPage::
+getMinMaxHeight(int &min_h, int &max_h) const
+{
+  if (heightResizable()) {
+    updateMinMax();
+
+    min_h = widgetMinSize_.height();
+    max_h = widgetMaxSize_.height();
+  }
+  else {
+    min_h = fixedHeight_;
+    max_h = min_h;
+  }
+}
+
+//------
+
+CQPaletteAreaFactoryPage::
+CQPaletteAreaFactoryPage() :
+ CQPaletteAreaPage(new QWidget), realized_(false), lastUsed_(0), loaded_(false),
+ loadWatcher_(0)
+{
+  setObjectName("factoryPage");
+
+  placeholder_ = widget();
+
+  placeholder_->setObjectName("placeholder");
+
+  // unused time starts when page stops being current (or shown)
+  connect(this, SIGNAL(visibilityChanged(CQPaletteAreaPage::Visibility)),
+          this, SLOT(visibilitySlot()));
+}
+
+CQPaletteAreaFactoryPage::
+~CQPaletteAreaFactoryPage()
+{
+  cancelLoad();
+
+  // placeholder is owned by page (unless already deleted with its parent)
+  if (! realized_)
+    delete placeholder_;
+}
+
+// set minimum size reported before widget is built
+void
+CQPaletteAreaFactoryPage::
+setMinimumSize(const QSize &size)
+{
+  minSize_ = size;
+
+  if (! realized_) {
+    widget()->setMinimumSize(size);
+
+    invalidateMinMax();
+  }
+}
+
+// build page widget (if not already built)
+void
+CQPaletteAreaFactoryPage::
+realize()
+{
+  if (realized_)
+    return;
+
+  // start async data load and build widget when loaded
+  if (! loaded_) {
+    load();
+
+    if (! loaded_)
+      return;
+  }
+
+  QWidget *w = createWidget();
+  assert(w);
+
+  realized_ = true;
+
+  setWidget(w);
+
+  if (data_.isValid())
+    applyData(data_);
+
+  // restore state saved when hibernated
+  if (state_.isValid()) {
+    restoreState(state_);
+
+    state_ = QVariant();
+  }
+
+  touch();
+}
+
+// destroy page widget (after saving its state) and use placeholder until next use
+void
+CQPaletteAreaFactoryPage::
+hibernate()
+{
+  if (! realized_)
+    return;
+
+  state_ = saveState();
+
+  QWidget *w = widget();
+
+  placeholder_ = new QWidget;
+
+  placeholder_->setObjectName("placeholder");
+  placeholder_->setMinimumSize(minSize_);
+
+  // visible pages have widget in group stack
+  if (group() && ! hidden())
+    group()->stack()->replaceWidget(w, placeholder_);
+
+  realized_ = false;
+
+  setWidget(placeholder_);
+
+  w->deleteLater();
+}
+
+// run page loader (on thread pool thread)
+static QVariant
+runPageLoader(QSharedPointer<CQPaletteAreaPageLoader> loader)
+{
+  if (loader->isCancelled())
+    return QVariant();
+
+  return loader->load();
+}
+
+// start async data load (if page has a loader and not already loaded or loading)
+void
+CQPaletteAreaFactoryPage::
+load()
+{
+  if (loaded_ || loadWatcher_)
+    return;
+
+  CQPaletteAreaPageLoader *loader = createLoader();
+
+  // no loader so data is loaded by createWidget
+  if (! loader) {
+    loaded_ = true;
+    return;
+  }
+
+  loader_ = LoaderP(loader);
+
+  // show loading message in placeholder
+  if (placeholder_ && ! placeholder_->layout()) {
+    QVBoxLayout *layout = new QVBoxLayout(placeholder_);
+
+    QLabel *label = new QLabel("Loading...");
+
+    label->setObjectName("loading");
+    label->setAlignment(Qt::AlignCenter);
+    label->setEnabled(false);
+
+    layout->addWidget(label);
+  }
+
+  loadWatcher_ = new LoadWatcher(this);
+
+  connect(loadWatcher_, SIGNAL(finished()), this, SLOT(loadedSlot()));
+
+  loadWatcher_->setFuture(QtConcurrent::run(runPageLoader, loader_));
+}
+
+// cancel async data load (result is discarded)
+void
+CQPaletteAreaFactoryPage::
+cancelLoad()
+{
+  if (! loadWatcher_)
+    return;
+
+  loader_->cancel();
+
+  // worker keeps its own reference to loader until it finishes
+  loader_.clear();
+
+  disconnect(loadWatcher_, SIGNAL(finished()), this, SLOT(loadedSlot()));
+
+  loadWatcher_->deleteLater();
+
+  loadWatcher_ = 0;
+}
+
+// async data loaded (GUI thread)
+void
+CQPaletteAreaFactoryPage::
+loadedSlot()
+{
+  if (! loadWatcher_ || sender() != loadWatcher_)
+    return;
+
+  data_ = loadWatcher_->result();
+
+  loadWatcher_->deleteLater();
+
+  loadWatcher_ = 0;
+
+  loader_.clear();
+
+  loaded_ = true;
+
+  emit dataLoaded();
+
+  // build widget now if page is waiting to be shown and apply its min/max size
+  // (placeholder's size was used until now)
+  if (isActive()) {
+    group()->stack()->setPage(this);
+
+    invalidateMinMax();
+
+    group()->updatePageSize(this);
+  }
+}
+
+// is page widget in use (current page of its group)
+bool
+CQPaletteAreaFactoryPage::
+isActive() const
+{
+  return (! hidden() && group() && group()->currentPage() == this);
+}
+
+// record page widget use time
+void
+CQPaletteAreaFactoryPage::
+touch()
+{
+  lastUsed_ = QDateTime::currentMSecsSinceEpoch();
+}
+
+void
+CQPaletteAreaFactoryPage::
+visibilitySlot()
+{
+  if (realized_)
+    touch();
+}
+
+// estimate of memory used by page widget (rough cost per child widget)
+qint64
+CQPaletteAreaFactoryPage::
+memoryCost() const
+{
+  if (! realized_)
+    return 0;
+
+  return qint64(widget()->findChildren<QWidget *>().size() + 1)*4096;
 }
@@ -9,7 +9,18 @@
 #include <QToolTip>
 #include <QDrag>
 #include <QMimeData>
-
+#include <QPixmapCache>
+#include <QVariantAnimation>
+#include <QTimer>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QKeyEvent>
+#include <QPointer>
+#include <QStaticText>
+#include <QtMath>
+
+#include <algorithm>
 #include <cassert>
 
 namespace {
@@ -17,19 +28,54 @@ static const char *dragId     = "CQTabBarDragId";
 static const char *mimeId     = "CQTabBarMimeId";
 static const char *mimeNameId = "CQTabBarMimeNameId";
 static const char *mimeTabId  = "CQTabBarMimeTabId";
+
+// source of current in-process drag (so drop targets don't need to parse mime data)
+static QPointer<CQTabBar> dragBar;
+static int                dragIndex = -1;
+
+// remove mnemonic markers from label text ('&x' -> 'x', '&&' -> '&')
+QString stripMnemonics(const QString &text)
+{
+  if (! text.contains(QLatin1Char('&')))
+    return text;
+
+  QString str;
+
+  str.reserve(text.length());
+
+  for (int i = 0; i < text.length(); ++i) {
+    if (text[i] == QLatin1Char('&') && i + 1 < text.length())
+      ++i;
+
+    str += text[i];
+  }
+
+  return str;
+}
+
+// does style use its own tab label colors (which are not available from the palette)
+bool styleDrawsTabLabel(const QStyle *style)
+{
+  return (style->inherits("QStyleSheetStyle") || style->inherits("QMacStyle"));
+}
 }
 
 // create tab bar
 CQTabBar::
 CQTabBar(QWidget *parent) :
- QWidget(parent), currentIndex_(-1), position_(North), allowNoTab_(false),
- buttonStyle_(Qt::ToolButtonIconOnly), iconSize_(16,16), iw_(0), w_(0), h_(0),
- clipNum_(-1), offset_(0), pressed_(false), pressIndex_(-1), moveIndex_(-1)
+ QWidget(parent), tabPosDirty_(-1), lastIndex_(0), currentIndex_(-1), position_(North), allowNoTab_(false),
+ buttonStyle_(Qt::ToolButtonIconOnly), renderCache_(false), menu_(0), iconSize_(16,16), iw_(0), w_(0), h_(0),
+ scrollPos_(0), maxScroll_(0), stripValid_(false), stripPos_(0), stripLen_(0), dragScroll_(false),
+ dragScrollPos_(0), dragScrollVelocity_(0.0), updateDepth_(0), updatePending_(false), pressed_(false),
+ pressIndex_(-1), moveIndex_(-1), dropPos_(-1)
 {
   setObjectName("tabBar");
 
   setAcceptDrops(true);
 
+  // track mouse for hover feedback
+  setMouseTracking(true);
+
   // add scroll buttons if tab bar is clipped
   lscroll_ = new CQTabBarScrollButton(this, "lscroll");
   rscroll_ = new CQTabBarScrollButton(this, "rscroll");
@@ -39,6 +85,39 @@ CQTabBar(QWidget *parent) :
 
   lscroll_->hide();
   rscroll_->hide();
+
+  // add overflow button (filterable list of all tabs) if tab bar is clipped
+  menuButton_ = new CQTabBarScrollButton(this, "menu");
+
+  menuButton_->setAutoRepeat(false);
+
+  connect(menuButton_, SIGNAL(clicked()), this, SLOT(menuSlot()));
+
+  menuButton_->hide();
+
+  // animate smooth scrolling
+  scrollAnim_ = new QVariantAnimation(this);
+
+  scrollAnim_->setEasingCurve(QEasingCurve::OutCubic);
+
+  connect(scrollAnim_, SIGNAL(valueChanged(const QVariant &)),
+          this, SLOT(scrollAnimSlot(const QVariant &)));
+
+  // detect end of scrolling (to release rendered strip)
+  scrollIdleTimer_ = new QTimer(this);
+
+  scrollIdleTimer_->setSingleShot(true);
+  scrollIdleTimer_->setInterval(SCROLL_IDLE_TIME);
+
+  connect(scrollIdleTimer_, SIGNAL(timeout()), this, SLOT(scrollIdleSlot()));
+
+  // coalesce tab badge, count and progress redraws
+  statusTimer_ = new QTimer(this);
+
+  statusTimer_->setSingleShot(true);
+  statusTimer_->setInterval(STATUS_TIME);
+
+  connect(statusTimer_, SIGNAL(timeout()), this, SLOT(statusSlot()));
 }
 
 // delete tab bar
@@ -109,25 +188,26 @@ int
 CQTabBar::
 insertTab(int ind, CQTabBarButton *button)
 {
-  buttons_.push_back(0);
+  int pos = qBound(0, ind, int(buttons_.size()));
 
-  for (int i = buttons_.size() - 1; i > ind; --i)
-    buttons_[i] = buttons_[i - 1];
+  buttons_.insert(buttons_.begin() + pos, button);
 
-  buttons_[ind] = button;
-
-  int index = buttons_.size();
+  // allocate unique index (independent of array pos so stays valid as tabs are removed)
+  int index = ++lastIndex_;
 
   button->setIndex(index);
 
+  if (button->widget())
+    widgetTabs_[button->widget()] = index;
+
+  updateTabPositions(pos);
+
   // update current
   if (! allowNoTab() && currentIndex() < 0)
     setCurrentIndex(index);
 
-  // update display
-  updateSizes();
-
-  update();
+  // update display (deferred if batched)
+  layoutTabs();
 
   return index;
 }
@@ -153,18 +233,30 @@ removeTab(int ind)
 
   CQTabBarButton *button = buttons_[pos];
 
-  buttons_[pos] = 0;
+  // compact button array and shift lookup of following buttons
+  buttons_.erase(buttons_.begin() + pos);
+
+  tabPos_.remove(ind);
+
+  if (button->widget())
+    widgetTabs_.remove(button->widget());
+
+  updateTabPositions(pos);
 
   delete button;
 
-  // reset current if deleted is current
-  if (currentIndex() == ind)
-    setCurrentIndex(-1);
+  // update display (deferred if batched)
+  layoutTabs();
 
-  // update display
-  updateSizes();
+  // if deleted is current then make neighbouring tab current (or none if allowed)
+  if (currentIndex() == ind) {
+    currentIndex_ = -1;
 
-  update();
+    if (! allowNoTab() && ! buttons_.empty())
+      setCurrentIndex(buttons_[std::min(pos, int(buttons_.size()) - 1)]->index());
+    else
+      emit currentChanged(currentIndex_);
+  }
 }
 
 // get number of tabs
@@ -172,16 +264,7 @@ int
 CQTabBar::
 count() const
 {
-  int n = 0;
-
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
-    if (! button) continue;
-
-    ++n;
-  }
-
-  return n;
+  return buttons_.size();
 }
 
 // get tab at count
@@ -189,19 +272,10 @@ int
 CQTabBar::
 tabInd(int i) const
 {
-  int n = 0;
-
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
-    if (! button) continue;
-
-    if (n == i)
-      return button->index();
-
-    ++n;
-  }
+  if (i < 0 || i >= count())
+    return -1;
 
-  return -1;
+  return buttons_[i]->index();
 }
 
 // set current tab
@@ -209,19 +283,19 @@ void
 CQTabBar::
 setCurrentIndex(int ind)
 {
-  // button array can contain empty slots so ensure the requested one is valid
+  // ensure the requested tab is valid
   CQTabBarButton *button = tabButton(ind);
   if (! button) return;
 
   // process if changed
   if (ind != currentIndex_) {
-    currentIndex_ = ind;
+    int oldIndex = currentIndex_;
 
-    // if one tab must be active and nothing active then use first non-null button
-    if (! allowNoTab() && currentIndex_ < 0 && count() > 0)
-      currentIndex_ = 0;
+    currentIndex_ = ind;
 
-    update();
+    // redraw old and new current tabs
+    updateTab(oldIndex);
+    updateTab(currentIndex_);
 
     emit currentChanged(currentIndex_);
   }
@@ -232,14 +306,12 @@ int
 CQTabBar::
 getTabIndex(QWidget *w) const
 {
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
+  WidgetTabs::const_iterator p = widgetTabs_.find(w);
 
-    if (button && button->widget() == w)
-      return button->index();
-  }
+  if (p == widgetTabs_.end())
+    return -1;
 
-  return -1;
+  return p.value();
 }
 
 // set tab location (relative to contents)
@@ -252,7 +324,8 @@ setPosition(const Position &position)
 
   position_ = position;
 
-  update();
+  // button rectangles depend on orientation
+  layoutTabs();
 }
 
 // set allow no current tab
@@ -263,7 +336,7 @@ setAllowNoTab(bool allow)
   allowNoTab_ = allow;
 
   if (! allowNoTab() && currentIndex() < 0 && count() > 0)
-    setCurrentIndex(0);
+    setCurrentIndex(tabInd(0));
 }
 
 // set tab button style
@@ -273,9 +346,9 @@ setButtonStyle(const Qt::ToolButtonStyle &buttonStyle)
 {
   buttonStyle_ = buttonStyle;
 
-  updateSizes();
+  invalidateSizes();
 
-  update();
+  layoutTabs();
 }
 
 // set tab text
@@ -288,9 +361,10 @@ setTabText(int ind, const QString &text)
   if (button)
     button->setText(text);
 
-  updateSizes();
+  if (menu_)
+    menu_->updateItem(ind);
 
-  update();
+  layoutTabs();
 }
 
 // set tab icon
@@ -303,9 +377,10 @@ setTabIcon(int ind, const QIcon &icon)
   if (button)
     button->setIcon(icon);
 
-  updateSizes();
+  if (menu_)
+    menu_->updateItem(ind);
 
-  update();
+  layoutTabs();
 }
 
 // set tab tooltip
@@ -326,12 +401,14 @@ setTabVisible(int ind, bool visible)
 {
   CQTabBarButton *button = tabButton(ind);
 
-  if (button)
+  if (button && button->visible() != visible) {
     button->setVisible(visible);
 
-  updateSizes();
+    if (menu_)
+      menu_->invalidateItems();
+  }
 
-  update();
+  layoutTabs();
 }
 
 // set tab pending state
@@ -341,10 +418,79 @@ setTabPending(int ind, bool pending)
 {
   CQTabBarButton *button = tabButton(ind);
 
-  if (button)
-    button->setPending(pending);
+  if (! button || button->pending() == pending)
+    return;
 
-  update();
+  button->setPending(pending);
+
+  updateTab(ind);
+}
+
+// set tab badge text
+void
+CQTabBar::
+setTabBadge(int ind, const QString &badge)
+{
+  CQTabBarButton *button = tabButton(ind);
+
+  if (! button || button->badge() == badge)
+    return;
+
+  button->setBadge(badge);
+
+  updateTabStatus(ind);
+}
+
+// set tab count (shown as badge if no badge text, 0 for none)
+void
+CQTabBar::
+setTabCount(int ind, int count)
+{
+  CQTabBarButton *button = tabButton(ind);
+
+  if (! button || button->count() == count)
+    return;
+
+  button->setCount(count);
+
+  updateTabStatus(ind);
+}
+
+// set tab progress (0.0 to 1.0, negative for none)
+void
+CQTabBar::
+setTabProgress(int ind, double progress)
+{
+  CQTabBarButton *button = tabButton(ind);
+
+  if (! button || button->progress() == progress)
+    return;
+
+  button->setProgress(progress);
+
+  updateTabStatus(ind);
+}
+
+// queue redraw of tab status (redrawn at most every STATUS_TIME ms)
+void
+CQTabBar::
+updateTabStatus(int ind)
+{
+  statusTabs_.insert(ind);
+
+  if (! statusTimer_->isActive())
+    statusTimer_->start();
+}
+
+// redraw tabs with changed status
+void
+CQTabBar::
+statusSlot()
+{
+  for (TabIndices::const_iterator p = statusTabs_.begin(); p != statusTabs_.end(); ++p)
+    updateTab(*p);
+
+  statusTabs_.clear();
 }
 
 // set tab data
@@ -376,14 +522,12 @@ CQTabBarButton *
 CQTabBar::
 tabButton(int ind) const
 {
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
+  int pos = lookupTabPos(ind);
 
-    if (button && button->index() == ind)
-      return button;
-  }
+  if (pos < 0)
+    return 0;
 
-  return 0;
+  return buttons_[pos];
 }
 
 // get array pos for tab
@@ -391,111 +535,160 @@ int
 CQTabBar::
 tabButtonPos(int ind) const
 {
-  for (int i = 0; i < int(buttons_.size()); ++i) {
-    CQTabBarButton *button = buttons_[i];
-
-    if (button && button->index() == ind)
-      return i;
-  }
+  int pos = lookupTabPos(ind);
 
-  assert(false);
+  assert(pos >= 0);
 
-  return -1;
+  return pos;
 }
 
-// get widget for tab
-QWidget *
+// lookup array pos for tab (-1 if none), updating stale entries if needed
+int
 CQTabBar::
-tabWidget(int ind) const
+lookupTabPos(int ind) const
 {
-  CQTabBarButton *button = tabButton(ind);
+  TabPositions::const_iterator p = tabPos_.find(ind);
 
-  if (button)
-    return button->widget();
+  if (p != tabPos_.end()) {
+    int pos = p.value();
 
-  return 0;
+    if (pos < int(buttons_.size()) && buttons_[pos]->index() == ind)
+      return pos;
+  }
+
+  if (tabPosDirty_ < 0)
+    return -1;
+
+  flushTabPositions();
+
+  p = tabPos_.find(ind);
+
+  if (p == tabPos_.end())
+    return -1;
+
+  return p.value();
 }
 
-// draw tab buttons
+// mark array pos lookup for buttons from specified pos to end as stale
 void
 CQTabBar::
-paintEvent(QPaintEvent *)
+updateTabPositions(int pos)
 {
-  QStylePainter stylePainter(this);
+  // lookup is updated lazily so batched inserts/removes only update it once
+  if (tabPosDirty_ < 0 || pos < tabPosDirty_)
+    tabPosDirty_ = pos;
 
-  //------
+  // tab order changed so overflow list must be rebuilt
+  if (menu_)
+    menu_->invalidateItems();
+}
 
-  // calculate width and height of region
-  int xo = 0;
+// update stale array pos lookup for buttons
+void
+CQTabBar::
+flushTabPositions() const
+{
+  if (tabPosDirty_ < 0)
+    return;
 
-  if (offset_ > 0) {
-    int offset = offset_;
+  for (int i = tabPosDirty_; i < int(buttons_.size()); ++i)
+    tabPos_[buttons_[i]->index()] = i;
 
-    for (TabButtons::const_iterator p = buttons_.begin(); offset > 0 && p != buttons_.end(); ++p) {
-      CQTabBarButton *button = *p;
+  tabPosDirty_ = -1;
+}
 
-      if (! button || ! button->visible()) continue;
+// begin batch of tab changes (layout and redraw deferred to matching endUpdate)
+void
+CQTabBar::
+beginUpdate()
+{
+  ++updateDepth_;
+}
 
-      xo += button->width();
+// end batch of tab changes (single layout and redraw if anything changed)
+void
+CQTabBar::
+endUpdate()
+{
+  assert(updateDepth_ > 0);
 
-      --offset;
-    }
-  }
+  if (--updateDepth_ > 0)
+    return;
 
-  int w = width ();
-  int h = height();
+  if (updatePending_) {
+    updatePending_ = false;
 
-  // set tab style
-  QStyleOptionTabV2 tabStyle;
+    updateSizes();
 
-  tabStyle.initFrom(this);
+    update();
+  }
+}
 
-  tabStyle.shape = getTabShape();
+// update tab sizes and redraw (deferred if batched)
+void
+CQTabBar::
+layoutTabs()
+{
+  if (updateDepth_ > 0) {
+    updatePending_ = true;
+    return;
+  }
 
-  int overlap = style()->pixelMetric(QStyle::PM_TabBarBaseOverlap, &tabStyle, this);
+  updateSizes();
 
-  // set tab base style
-  QStyleOptionTabBarBaseV2 baseStyle;
+  update();
+}
 
-  baseStyle.initFrom(this);
+// update tab rectangles and extents now if layout is deferred by batch so tab and drop
+// position queries inside a batch see current tabs (redraw stays pending for endUpdate)
+void
+CQTabBar::
+flushLayout() const
+{
+  if (updateDepth_ > 0 && updatePending_)
+    const_cast<CQTabBar *>(this)->updateSizes();
+}
 
-  // calculate button geometry and first/last tab buttons
-  CQTabBarButton *firstButton = 0;
-  CQTabBarButton *lastButton  = 0;
+// get widget for tab
+QWidget *
+CQTabBar::
+tabWidget(int ind) const
+{
+  CQTabBarButton *button = tabButton(ind);
 
-  int x = -xo;
+  if (button)
+    return button->widget();
 
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
+  return 0;
+}
 
-    if (! button || ! button->visible()) continue;
+// draw tab buttons
+void
+CQTabBar::
+paintEvent(QPaintEvent *e)
+{
+  QStylePainter stylePainter(this);
 
-    if (firstButton == 0)
-      firstButton = button;
-    else
-      lastButton = button;
+  //------
 
-    // calc button width
-    int w1 = button->width();
+  // button rectangles are precalculated by updateSizes so just draw
+  int w = width ();
+  int h = height();
 
-    // calculate and store button rectangle
-    QRect r;
+  // set tab base style
+  QStyleOptionTabBarBaseV2 baseStyle;
 
-    if (isVertical())
-      r = QRect(0, x, h_, w1);
-    else
-      r = QRect(x, 0, w1, h_);
+  baseStyle.initFrom(this);
 
-    button->setRect(r);
+  baseStyle.shape = getTabShape();
 
-    // update base line rectangle
-    if (button->index() == currentIndex())
-      baseStyle.selectedTabRect = r;
+  int overlap = style()->pixelMetric(QStyle::PM_TabBarBaseOverlap, &baseStyle, this);
 
-    //-----
+  // update base line rectangle
+  CQTabBarButton *currentButton = tabButton(currentIndex());
 
-    x += w1;
-  }
+  if (currentButton && currentButton->visible())
+    baseStyle.selectedTabRect = tabRect(currentButton);
 
   // draw tab base
   if      (position_ == North)
@@ -507,19 +700,66 @@ paintEvent(QPaintEvent *)
   else if (position_ == East)
     baseStyle.rect = QRect(0, 0, overlap, h);
 
-  baseStyle.shape = getTabShape();
-
   stylePainter.drawPrimitive(QStyle::PE_FrameTabBarBase, baseStyle);
 
   //------
 
-  // draw buttons
-  x = -xo;
+  // while scrolling just blit the rendered tab strip, otherwise draw tabs in update region
+  if (isScrolling()) {
+    updateStrip();
+
+    int xo = stripPos_ - scrollPos_;
+
+    if (isVertical())
+      stylePainter.drawPixmap(0, xo, strip_);
+    else
+      stylePainter.drawPixmap(xo, 0, strip_);
+  }
+  else
+    drawTabs(&stylePainter, e->region(), scrollOffset());
+
+  // draw drop insertion marker
+  if (dropPos_ >= 0)
+    stylePainter.fillRect(dropMarkerRect(dropPos_).adjusted(1, 1, -1, -1), palette().highlight());
+}
+
+// draw visible tabs in region (tab rectangles offset by xo)
+void
+CQTabBar::
+drawTabs(QPainter *painter, const QRegion &region, int xo)
+{
+  // set tab style
+  QStyleOptionTabV2 tabStyle;
+
+  // get first/last tab buttons
+  int nv = visibleTabs_.size();
 
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
+  CQTabBarButton *firstButton = (nv > 0 ? buttons_[visibleTabs_[0     ]] : 0);
+  CQTabBarButton *lastButton  = (nv > 1 ? buttons_[visibleTabs_[nv - 1]] : 0);
 
-    if (! button || ! button->visible()) continue;
+  // get range of visible buttons in region (from tab extents)
+  int m = TAB_BORDER/2;
+
+  QRect updateRect = region.boundingRect().adjusted(-m, -m, m, m);
+
+  int x1 = (isVertical() ? updateRect.top   () : updateRect.left ()) + xo;
+  int x2 = (isVertical() ? updateRect.bottom() : updateRect.right()) + xo;
+
+  int k1 = visibleTabAt(std::max(x1, 0));
+  int k2 = visibleTabAt(x2);
+
+  if (k1 < 0) k1 = (x1 < 0 ? 0 : nv);
+  if (k2 < 0) k2 = nv - 1;
+
+  // draw buttons (skip those outside the region)
+  for (int k = k1; k <= k2; ++k) {
+    CQTabBarButton *button = buttons_[visibleTabs_[k]];
+
+    QRect r = (isVertical() ? button->rect().translated(0, -xo) :
+                              button->rect().translated(-xo, 0));
+
+    if (! region.intersects(r.adjusted(-m, -m, m, m)))
+      continue;
 
     //----
 
@@ -528,7 +768,7 @@ paintEvent(QPaintEvent *)
 
     tabStyle.state &= ~(QStyle::State_HasFocus | QStyle::State_MouseOver);
 
-    tabStyle.rect = button->rect();
+    tabStyle.rect = r;
 
     tabStyle.row = 0;
 
@@ -567,76 +807,380 @@ paintEvent(QPaintEvent *)
     if (button->pending())
       tabStyle.palette.setColor(QPalette::Button, QColor("#0000FF"));
 
-    // draw button
-    stylePainter.drawControl(QStyle::CE_TabBarTab, tabStyle);
-
-    //-----
+    // draw button (from rendered tab cache if enabled)
+    if (renderCache_)
+      drawCachedTab(painter, button, tabStyle);
+    else
+      drawTab(painter, button, tabStyle);
 
-    x += button->width();
+    // draw badge and progress over button
+    if (button->hasStatus())
+      drawTabStatus(painter, button, r);
   }
-
-  // update scroll buttons
-  lscroll_->setEnabled(offset_ > 0);
-  rscroll_->setEnabled(offset_ < clipNum_);
 }
 
-// handle resize
+// draw tab (style draws shape, text labels are drawn from prepared static text)
 void
 CQTabBar::
-resizeEvent(QResizeEvent *)
+drawTab(QPainter *painter, const CQTabBarButton *button, const QStyleOptionTab &tabStyle)
 {
-  updateSizes();
-}
+  if (buttonStyle_ == Qt::ToolButtonIconOnly || styleDrawsTabLabel(style())) {
+    style()->drawControl(QStyle::CE_TabBarTab, &tabStyle, painter, this);
+    return;
+  }
 
-// update size of tab area
-void
-CQTabBar::
-updateSizes()
-{
-  // calculate width and height of region
-  QFontMetrics fm(font());
+  style()->drawControl(QStyle::CE_TabBarTabShape, &tabStyle, painter, this);
 
-  int iw = iconSize().width();
-  int h  = qMax(iw, fm.height()) + TAB_BORDER;
+  //---
 
-  // remove resize width
-  if (isVertical())
-    h = qMin(h, width () - RESIZE_WIDTH);
-  else
-    h = qMin(h, height() - RESIZE_WIDTH);
+  const QRect &r = tabStyle.rect;
 
-  int w = 0;
+  // transform from horizontal label coords to tab coords (text reads up for West, down for East)
+  QTransform t;
 
-  clipNum_ = 0;
+  int len, thickness;
 
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
+  if      (position_ == West) {
+    t.translate(r.left(), r.bottom() + 1); t.rotate(-90);
 
-    if (! button || ! button->visible()) continue;
+    len = r.height(); thickness = r.width();
+  }
+  else if (position_ == East) {
+    t.translate(r.right() + 1, r.top()); t.rotate(90);
 
-    w += button->width();
+    len = r.height(); thickness = r.width();
+  }
+  else {
+    t.translate(r.left(), r.top());
 
-    if (isVertical()) {
-      if (w > height())
-        ++clipNum_;
-    }
-    else {
-      if (w > width())
-        ++clipNum_;
-    }
+    len = r.width(); thickness = r.height();
   }
 
-  iw_ = iw;
-  w_  = w;
+  // center icon and text along tab
+  const QStaticText &text = button->staticText();
+
+  QSizeF ts = text.size();
+
+  bool showIcon = (buttonStyle_ == Qt::ToolButtonTextBesideIcon && ! button->icon().isNull());
+
+  int iw = (showIcon ? iw_ + 8 : 0);
+
+  int x = (len - iw - qCeil(ts.width()))/2;
+
+  if (showIcon) {
+    // draw icon unrotated (rotated icon is cached for tab position)
+    QRect ir = t.mapRect(QRect(x, (thickness - iw_)/2, iw_, iw_));
+
+    QIcon::Mode mode = (tabStyle.state & QStyle::State_Enabled ? QIcon::Normal : QIcon::Disabled);
+
+    button->positionIcon(position_).paint(painter, ir, Qt::AlignCenter, mode);
+  }
+
+  painter->save();
+
+  painter->setTransform(t, true);
+
+  // label color for tab state (as used by common style tab label)
+  QPalette::ColorGroup cg = QPalette::Disabled;
+
+  if (tabStyle.state & QStyle::State_Enabled)
+    cg = (tabStyle.state & QStyle::State_Active ? QPalette::Active : QPalette::Inactive);
+
+  painter->setFont(font());
+  painter->setPen (tabStyle.palette.color(cg, QPalette::WindowText));
+
+  painter->drawStaticText(QPointF(x + iw, (thickness - ts.height())/2.0), text);
+
+  painter->restore();
+}
+
+// draw tab badge/count and progress
+void
+CQTabBar::
+drawTabStatus(QPainter *painter, const CQTabBarButton *button, const QRect &r)
+{
+  painter->save();
+
+  painter->setRenderHint(QPainter::Antialiasing, true);
+
+  // draw progress bar along outer edge of tab
+  if (button->progress() >= 0.0) {
+    double f = std::min(button->progress(), 1.0);
+
+    QRect pr;
+
+    if (isVertical()) {
+      int x = (position_ == West ? r.left() + 2 : r.right() - 4);
+
+      pr = QRect(x, r.top() + 2, 3, int(f*(r.height() - 4)));
+    }
+    else {
+      int y = (position_ == North ? r.top() + 2 : r.bottom() - 4);
+
+      pr = QRect(r.left() + 2, y, int(f*(r.width() - 4)), 3);
+    }
+
+    painter->fillRect(pr, palette().highlight());
+  }
+
+  // draw badge text (or count) in top right corner
+  QString text = button->badge();
+
+  if (text.isEmpty() && button->count() > 0)
+    text = (button->count() > 99 ? QString("99+") : QString::number(button->count()));
+
+  if (! text.isEmpty()) {
+    QFont font = this->font();
+
+    if (font.pointSizeF() > 0)
+      font.setPointSizeF(0.75*font.pointSizeF());
+    else
+      font.setPixelSize(std::max(int(0.75*font.pixelSize()), 1));
+
+    QFontMetrics fm(font);
+
+    int bh = fm.height();
+    int bw = std::max(fm.width(text) + 4, bh);
+
+    QRect br(r.right() - bw - 1, r.top() + 1, bw, bh);
+
+    painter->setPen  (Qt::NoPen);
+    painter->setBrush(palette().highlight());
+
+    painter->drawRoundedRect(br, bh/2.0, bh/2.0);
+
+    painter->setFont(font);
+    painter->setPen (palette().highlightedText().color());
+
+    painter->drawText(br, Qt::AlignCenter, text);
+  }
+
+  painter->restore();
+}
+
+// render strip of tabs around scroll position (reused until scrolled outside it)
+void
+CQTabBar::
+updateStrip()
+{
+  int len = (isVertical() ? height() : width());
+
+  // visible end clamped to tabs end (scroll range includes space for scroll buttons)
+  int end = std::min(scrollPos_ + len, w_);
+
+  if (stripValid_ && scrollPos_ >= stripPos_ && end <= stripPos_ + stripLen_)
+    return;
+
+  // strip is a few tab bar lengths centered on the scroll position
+  int sl = std::max(std::min(w_, STRIP_VIEWS*len), len);
+
+  stripPos_ = std::max(std::min(scrollPos_ - (sl - len)/2, w_ - sl), 0);
+  stripLen_ = sl;
+
+  QSize s = (isVertical() ? QSize(width(), sl) : QSize(sl, height()));
+
+  qreal dpr = devicePixelRatioF();
+
+  strip_ = QPixmap(s*dpr);
+
+  strip_.setDevicePixelRatio(dpr);
+
+  strip_.fill(Qt::transparent);
+
+  QPainter painter(&strip_);
+
+  drawTabs(&painter, QRegion(QRect(QPoint(0, 0), s)), stripPos_);
+
+  stripValid_ = true;
+}
+
+// discard rendered tab strip
+void
+CQTabBar::
+invalidateStrip()
+{
+  stripValid_ = false;
+}
+
+// draw tab using pixmap rendered once per tab state
+void
+CQTabBar::
+drawCachedTab(QPainter *painter, const CQTabBarButton *button, const QStyleOptionTab &tabStyle)
+{
+  // extra margin for styles which draw outside the tab rectangle
+  int m = TAB_BORDER/2;
+
+  const QRect &r = tabStyle.rect;
+
+  qreal dpr = devicePixelRatioF();
+
+  // key for all values which affect the tab drawing
+  QString key = QString("CQTabBar:%1:%2:%3:%4:%5:%6:%7:%8:%9").
+    arg(int(tabStyle.shape)).arg(int(tabStyle.position)).arg(int(tabStyle.state)).
+    arg(r.width()).arg(r.height()).arg(button->icon().cacheKey()).arg(dpr).
+    arg(int(button->pending())).arg(tabStyle.text);
+
+  key += QString(":%1:%2:%3").arg(palette().cacheKey()).arg(quintptr(style())).arg(font().key());
+
+  QPixmap pixmap;
+
+  if (! QPixmapCache::find(key, &pixmap)) {
+    QSize size(r.width() + 2*m, r.height() + 2*m);
+
+    pixmap = QPixmap(size*dpr);
+
+    pixmap.setDevicePixelRatio(dpr);
+
+    pixmap.fill(Qt::transparent);
+
+    QStyleOptionTab tabStyle1 = tabStyle;
+
+    tabStyle1.rect = QRect(m, m, r.width(), r.height());
+
+    QPainter pixmapPainter(&pixmap);
+
+    drawTab(&pixmapPainter, button, tabStyle1);
+
+    pixmapPainter.end();
+
+    QPixmapCache::insert(key, pixmap);
+  }
+
+  painter->drawPixmap(r.topLeft() - QPoint(m, m), pixmap);
+}
+
+// set whether rendered tabs are cached
+void
+CQTabBar::
+setRenderCache(bool cache)
+{
+  renderCache_ = cache;
+
+  update();
+}
+
+// handle resize
+void
+CQTabBar::
+resizeEvent(QResizeEvent *)
+{
+  updateSizes();
+}
+
+// update size of tab area
+void
+CQTabBar::
+updateSizes()
+{
+  // calculate width and height of region
+  QFontMetrics fm(font());
+
+  int iw = iconSize().width();
+  int h  = qMax(iw, fm.height()) + TAB_BORDER;
+
+  // remove resize width
+  if (isVertical())
+    h = qMin(h, width () - RESIZE_WIDTH);
+  else
+    h = qMin(h, height() - RESIZE_WIDTH);
+
+  // button widths depend on icon width so set before calculating them
+  iw_ = iw;
   h_  = h;
 
+  // calculate button rectangles (unscrolled) and extents of visible buttons
+  visibleTabs_.clear();
+  tabExtents_ .clear();
+
+  int w = 0;
+
+  tabExtents_.push_back(w);
+
+  for (int i = 0; i < int(buttons_.size()); ++i) {
+    CQTabBarButton *button = buttons_[i];
+
+    if (! button->visible()) {
+      button->setRect(QRect());
+      continue;
+    }
+
+    int w1 = button->width(); // cached unless invalidated
+
+    if (isVertical())
+      button->setRect(QRect(0, w, h_, w1));
+    else
+      button->setRect(QRect(w, 0, w1, h_));
+
+    w += w1;
+
+    visibleTabs_.push_back(i);
+    tabExtents_ .push_back(w);
+  }
+
+  w_ = w;
+
+  // calc scroll range if clipped by tab bar length (leaving room for scroll buttons)
+  int len = (isVertical() ? height() : width());
+
+  maxScroll_ = (w_ > len ? std::max(w_ - (len - 3*iw_), 0) : 0);
+
   //-----
 
   // update scroll if clipped
-  showScrollButtons(clipNum_ > 0);
+  showScrollButtons(maxScroll_ > 0);
+
+  invalidateStrip();
+
+  if (scrollPos_ > maxScroll_) {
+    scrollAnim_->stop();
 
-  if (offset_ > clipNum_)
-    offset_ = clipNum_;
+    scrollPos_ = maxScroll_;
+  }
+
+  updateScrollButtons();
+}
+
+// invalidate cached button widths (font, icon size or button style changed)
+void
+CQTabBar::
+invalidateSizes()
+{
+  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p)
+    (*p)->invalidateWidth();
+}
+
+// get scroll offset (pixels)
+int
+CQTabBar::
+scrollOffset() const
+{
+  return scrollPos_;
+}
+
+// get visible button number (not index) at unscrolled position (binary search of extents)
+int
+CQTabBar::
+visibleTabAt(int x) const
+{
+  if (tabExtents_.size() < 2 || x < 0 || x >= tabExtents_.back())
+    return -1;
+
+  std::vector<int>::const_iterator p = std::upper_bound(tabExtents_.begin(), tabExtents_.end(), x);
+
+  return int(p - tabExtents_.begin()) - 1;
+}
+
+// get button rectangle in widget coordinates (applies scroll offset)
+QRect
+CQTabBar::
+tabRect(const CQTabBarButton *button) const
+{
+  int xo = scrollOffset();
+
+  if (isVertical())
+    return button->rect().translated(0, -xo);
+  else
+    return button->rect().translated(-xo, 0);
 }
 
 // update scroll buttons
@@ -644,8 +1188,9 @@ void
 CQTabBar::
 showScrollButtons(bool show)
 {
-  lscroll_->setVisible(show);
-  rscroll_->setVisible(show);
+  lscroll_   ->setVisible(show);
+  rscroll_   ->setVisible(show);
+  menuButton_->setVisible(show);
 
   if (show) {
     // position scroll buttons depending in tab position
@@ -655,14 +1200,17 @@ showScrollButtons(bool show)
 
       int d = h_ - xs;
 
-      lscroll_->setFixedSize(xs, ys);
-      rscroll_->setFixedSize(xs, ys);
+      lscroll_   ->setFixedSize(xs, ys);
+      rscroll_   ->setFixedSize(xs, ys);
+      menuButton_->setFixedSize(xs, ys);
 
-      lscroll_->move(d, height() - 2*ys);
-      rscroll_->move(d, height() -   ys);
+      menuButton_->move(d, height() - 3*ys);
+      lscroll_   ->move(d, height() - 2*ys);
+      rscroll_   ->move(d, height() -   ys);
 
-      lscroll_->setArrowType(Qt::UpArrow);
-      rscroll_->setArrowType(Qt::DownArrow);
+      lscroll_   ->setArrowType(Qt::UpArrow);
+      rscroll_   ->setArrowType(Qt::DownArrow);
+      menuButton_->setArrowType(position_ == West ? Qt::RightArrow : Qt::LeftArrow);
     }
     else {
       int xs = iconWidth();
@@ -670,18 +1218,111 @@ showScrollButtons(bool show)
 
       int d = h_ - ys;
 
-      lscroll_->setFixedSize(xs, ys);
-      rscroll_->setFixedSize(xs, ys);
+      lscroll_   ->setFixedSize(xs, ys);
+      rscroll_   ->setFixedSize(xs, ys);
+      menuButton_->setFixedSize(xs, ys);
 
-      lscroll_->move(width() - 2*xs, d);
-      rscroll_->move(width() -   xs, d);
+      menuButton_->move(width() - 3*xs, d);
+      lscroll_   ->move(width() - 2*xs, d);
+      rscroll_   ->move(width() -   xs, d);
 
-      lscroll_->setArrowType(Qt::LeftArrow);
-      rscroll_->setArrowType(Qt::RightArrow);
+      lscroll_   ->setArrowType(Qt::LeftArrow);
+      rscroll_   ->setArrowType(Qt::RightArrow);
+      menuButton_->setArrowType(position_ == North ? Qt::DownArrow : Qt::UpArrow);
     }
   }
-  else
-    offset_ = 0;
+}
+
+// enable scroll buttons for scroll position
+void
+CQTabBar::
+updateScrollButtons()
+{
+  lscroll_->setEnabled(scrollPos_ > 0);
+  rscroll_->setEnabled(scrollPos_ < maxScroll_);
+}
+
+// set scroll position (pixels) and redraw
+void
+CQTabBar::
+setScrollPos(int pos)
+{
+  pos = std::max(std::min(pos, maxScroll_), 0);
+
+  if (pos == scrollPos_)
+    return;
+
+  scrollPos_ = pos;
+
+  // use rendered strip until scrolling stops
+  scrollIdleTimer_->start();
+
+  updateScrollButtons();
+
+  update();
+}
+
+// get scroll position being scrolled to (end of animation if running)
+int
+CQTabBar::
+scrollTarget() const
+{
+  if (scrollAnim_->state() == QAbstractAnimation::Running)
+    return scrollAnim_->endValue().toInt();
+
+  return scrollPos_;
+}
+
+// smooth scroll to position
+void
+CQTabBar::
+scrollTo(int pos, int duration)
+{
+  pos = std::max(std::min(pos, maxScroll_), 0);
+
+  scrollAnim_->stop();
+
+  if (pos == scrollPos_)
+    return;
+
+  scrollAnim_->setDuration   (duration);
+  scrollAnim_->setStartValue (scrollPos_);
+  scrollAnim_->setEndValue   (pos);
+
+  scrollAnim_->start();
+}
+
+// check if scrolling (animating, dragging or recently scrolled)
+bool
+CQTabBar::
+isScrolling() const
+{
+  return (scrollAnim_->state() == QAbstractAnimation::Running ||
+          dragScroll_ || scrollIdleTimer_->isActive());
+}
+
+// called on scroll animation step
+void
+CQTabBar::
+scrollAnimSlot(const QVariant &value)
+{
+  setScrollPos(value.toInt());
+}
+
+// called when scrolling has stopped
+void
+CQTabBar::
+scrollIdleSlot()
+{
+  if (isScrolling())
+    return;
+
+  // release strip and redraw from style
+  strip_ = QPixmap();
+
+  invalidateStrip();
+
+  update();
 }
 
 // called when left/bottom scroll is pressed
@@ -689,13 +1330,15 @@ void
 CQTabBar::
 lscrollSlot()
 {
-  // scroll to previous tab (if any)
-  --offset_;
+  // scroll to start of previous tab (if any)
+  int pos = scrollTarget();
 
-  if (offset_ < 0)
-    offset_ = 0;
+  std::vector<int>::const_iterator p = std::lower_bound(tabExtents_.begin(), tabExtents_.end(), pos);
 
-  update();
+  if (p != tabExtents_.begin())
+    --p;
+
+  scrollTo(p != tabExtents_.end() ? *p : 0);
 }
 
 // called when right/top scroll is pressed
@@ -703,13 +1346,67 @@ void
 CQTabBar::
 rscrollSlot()
 {
-  // scroll to next tab (if any)
-  ++offset_;
+  // scroll to start of next tab (if any)
+  int pos = scrollTarget();
 
-  if (offset_ > clipNum_)
-    offset_ = clipNum_;
+  std::vector<int>::const_iterator p = std::upper_bound(tabExtents_.begin(), tabExtents_.end(), pos);
 
-  update();
+  scrollTo(p != tabExtents_.end() ? *p : maxScroll_);
+}
+
+// called when overflow button is pressed
+void
+CQTabBar::
+menuSlot()
+{
+  // popup list of tabs (created on first use)
+  if (! menu_)
+    menu_ = new CQTabBarMenu(this);
+
+  menu_->updateItems();
+
+  QPoint pos;
+
+  if      (position_ == North)
+    pos = menuButton_->mapToGlobal(menuButton_->rect().bottomLeft());
+  else if (position_ == South)
+    pos = menuButton_->mapToGlobal(menuButton_->rect().topLeft() - QPoint(0, menu_->height()));
+  else if (position_ == West)
+    pos = menuButton_->mapToGlobal(menuButton_->rect().topRight());
+  else
+    pos = menuButton_->mapToGlobal(menuButton_->rect().topLeft() - QPoint(menu_->width(), 0));
+
+  menu_->move(pos);
+
+  menu_->show();
+}
+
+// scroll so tab is fully visible (if clipped)
+void
+CQTabBar::
+ensureTabVisible(int ind)
+{
+  flushLayout();
+
+  CQTabBarButton *button = tabButton(ind);
+
+  if (! button || ! button->visible() || maxScroll_ <= 0)
+    return;
+
+  // length of tab row not covered by scroll buttons
+  int len = (isVertical() ? height() : width()) - 3*iw_;
+
+  const QRect &r = button->rect();
+
+  int x1 = (isVertical() ? r.top   () : r.left ());
+  int x2 = (isVertical() ? r.bottom() : r.right()) + 1;
+
+  int pos = scrollTarget();
+
+  if      (x1 < pos)
+    scrollTo(x1);
+  else if (x2 > pos + len)
+    scrollTo(x2 - len);
 }
 
 // handle tool tip event
@@ -725,10 +1422,17 @@ event(QEvent *e)
     if (ind != -1) {
       CQTabBarButton *button = tabButton(ind);
 
-      if (button)
+      if      (showTabToolTip(ind, helpEvent->globalPos()))
+        QToolTip::hideText();
+      else if (button) {
+        hideTabToolTip();
+
         QToolTip::showText(helpEvent->globalPos(), button->toolTip());
+      }
     }
     else {
+      hideTabToolTip();
+
       QToolTip::hideText();
 
       e->ignore();
@@ -736,6 +1440,14 @@ event(QEvent *e)
 
     return true;
   }
+  else if (e->type() == QEvent::Leave || e->type() == QEvent::MouseButtonPress) {
+    hideTabToolTip();
+  }
+  else if (e->type() == QEvent::FontChange) {
+    invalidateSizes();
+
+    updateSizes();
+  }
 
   return QWidget::event(e);
 }
@@ -750,15 +1462,8 @@ sizeHint() const
   int iw = iconSize().width();
   int h  = qMax(iw, fm.height()) + TAB_BORDER + RESIZE_WIDTH;
 
-  int w = 0;
-
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
-
-    if (! button || ! button->visible()) continue;
-
-    w += button->width();
-  }
+  // total button width is cached by updateSizes
+  int w = w_;
 
   if (isVertical())
     return QSize(h, w);
@@ -784,35 +1489,124 @@ void
 CQTabBar::
 setPressPoint(const QPoint &p)
 {
-  pressed_    = true;
-  pressPos_   = p;
-  pressIndex_ = tabAt(pressPos_);
+  pressed_  = true;
+  pressPos_ = p;
+
+  setPressIndex(tabAt(pressPos_));
+}
+
+// set tab at press position (redraw changed tabs)
+void
+CQTabBar::
+setPressIndex(int ind)
+{
+  if (ind == pressIndex_)
+    return;
+
+  int oldIndex = pressIndex_;
+
+  pressIndex_ = ind;
+
+  updateTab(oldIndex);
+  updateTab(pressIndex_);
+}
+
+// set tab at mouse position (redraw changed tabs)
+void
+CQTabBar::
+setMoveIndex(int ind)
+{
+  if (ind == moveIndex_)
+    return;
+
+  int oldIndex = moveIndex_;
+
+  moveIndex_ = ind;
+
+  updateTab(oldIndex);
+  updateTab(moveIndex_);
 }
 
-// handle mouse press
-void
-CQTabBar::
-mousePressEvent(QMouseEvent *e)
-{
-  // init press state and redraw
+// redraw area of single tab
+void
+CQTabBar::
+updateTab(int ind)
+{
+  CQTabBarButton *button = tabButton(ind);
+
+  if (! button || ! button->visible())
+    return;
+
+  // full redraw pending if batched
+  if (updateDepth_ > 0) {
+    updatePending_ = true;
+    return;
+  }
+
+  // include margin for styles which draw selected/hover tabs outside the tab rectangle
+  int m = TAB_BORDER/2;
+
+  invalidateStrip();
+
+  update(tabRect(button).adjusted(-m, -m, m, m));
+}
+
+// handle mouse press
+void
+CQTabBar::
+mousePressEvent(QMouseEvent *e)
+{
+  // middle button drags tab row if clipped
+  if (e->button() == Qt::MiddleButton && maxScroll_ > 0) {
+    scrollAnim_->stop();
+
+    dragScroll_         = true;
+    dragScrollPos_      = (isVertical() ? e->pos().y() : e->pos().x());
+    dragScrollVelocity_ = 0.0;
+
+    dragScrollTime_.start();
+
+    return;
+  }
+
+  // init press state (redraws pressed tab)
   setPressPoint(e->pos());
-
-  update();
 }
 
-// handle mouse move (while pressed)
+// handle mouse move
 void
 CQTabBar::
 mouseMoveEvent(QMouseEvent *e)
 {
-  // update press state and redraw
-  if (! pressed_)
-    setPressPoint(e->pos());
+  // scroll with drag (track velocity for fling on release)
+  if (dragScroll_) {
+    int pos = (isVertical() ? e->pos().y() : e->pos().x());
+    int d   = dragScrollPos_ - pos;
+
+    qint64 dt = dragScrollTime_.restart();
+
+    if (dt > 0)
+      dragScrollVelocity_ = 0.8*(double(d)/dt) + 0.2*dragScrollVelocity_;
+
+    dragScrollPos_ = pos;
+
+    setScrollPos(scrollPos_ + d);
+
+    return;
+  }
+
+  // update hover tab
+  setMoveIndex(tabAt(e->pos()));
 
   // If left button pressed check for drag
   if (e->buttons() & Qt::LeftButton) {
-    // check drag distance
-    if ((e->pos() - pressPos_).manhattanLength() >= QApplication::startDragDistance()) {
+    // update press state
+    if (! pressed_)
+      setPressPoint(e->pos());
+
+    // check drag distance (from a tab)
+    if (pressIndex_ >= 0 &&
+        (e->pos() - pressPos_).manhattanLength() >= QApplication::startDragDistance()) {
       CQTabBarButton *button = tabButton(pressIndex_);
 
       QIcon icon = (button ? button->icon() : QIcon());
@@ -833,11 +1627,29 @@ mouseMoveEvent(QMouseEvent *e)
 
       drag->setMimeData(mimeData);
 
+      // record in-process drag source (mime data is only needed by other processes)
+      dragBar   = this;
+      dragIndex = pressIndex_;
+
       drag->exec();
+
+      dragBar   = 0;
+      dragIndex = -1;
+
+      // drag consumes release so reset press state
+      pressed_ = false;
+
+      setPressIndex(-1);
     }
   }
+}
 
-  update();
+// handle mouse leave
+void
+CQTabBar::
+leaveEvent(QEvent *)
+{
+  setMoveIndex(-1);
 }
 
 // handle mouse release
@@ -845,26 +1657,70 @@ void
 CQTabBar::
 mouseReleaseEvent(QMouseEvent *e)
 {
-  // reset pressed state
+  // end drag scroll (fling if still moving)
+  if (dragScroll_) {
+    if (e->button() != Qt::MiddleButton)
+      return;
+
+    dragScroll_ = false;
+
+    if (dragScrollTime_.elapsed() < SCROLL_IDLE_TIME && qAbs(dragScrollVelocity_) > 0.1)
+      scrollTo(scrollPos_ + int(dragScrollVelocity_*FLING_TIME/2), FLING_TIME);
+    else
+      scrollIdleTimer_->start();
+
+    return;
+  }
+
+  // reset pressed state (redraws pressed tab)
   pressed_ = false;
 
+  setPressIndex(-1);
+
   // check if new tab button is pressed
-  pressIndex_ = tabAt(e->pos());
+  int ind = tabAt(e->pos());
 
-  bool isCurrent = (pressIndex_ != -1 && pressIndex_ == currentIndex());
+  bool isCurrent = (ind != -1 && ind == currentIndex());
 
-  if (pressIndex_ != -1) {
+  if (ind != -1) {
     if (! isCurrent)
-      setCurrentIndex(pressIndex_); // will send currentChanged signal
+      setCurrentIndex(ind); // will send currentChanged signal
     else
-      emit currentPressed(pressIndex_);
+      emit currentPressed(ind);
   }
 
   // signal tab button pressed
-  emit tabPressedSignal(pressIndex_, ! isCurrent);
+  emit tabPressedSignal(ind, ! isCurrent);
+}
 
-  // redraw
-  update();
+// handle mouse wheel (pixel deltas for touchpad, animated steps for wheel)
+void
+CQTabBar::
+wheelEvent(QWheelEvent *e)
+{
+  if (maxScroll_ <= 0) {
+    e->ignore();
+    return;
+  }
+
+  QPoint pd = e->pixelDelta();
+  QPoint ad = e->angleDelta();
+
+  if (! pd.isNull()) {
+    int d = (qAbs(pd.x()) > qAbs(pd.y()) ? pd.x() : pd.y());
+
+    scrollAnim_->stop();
+
+    setScrollPos(scrollPos_ - d);
+  }
+  else {
+    int d = (qAbs(ad.x()) > qAbs(ad.y()) ? ad.x() : ad.y());
+
+    // scroll three tab heights per wheel step (120 units)
+    scrollTo(scrollTarget() - d*3*h_/120);
+  }
+
+  e->accept();
 }
 
 // handle drag enter event
@@ -872,10 +1728,12 @@ void
 CQTabBar::
 dragEnterEvent(QDragEnterEvent *event)
 {
-  QString name;
-  int     fromIndex;
+  CQTabBar *bar;
+  QString   name;
+  int       fromIndex;
 
-  if (! dragValid(event->mimeData(), name, fromIndex)) {
+  // only drags from a tab bar in this process can be handled
+  if (! dragValid(event->mimeData(), bar, name, fromIndex) || ! bar) {
     event->ignore();
     return;
   }
@@ -883,23 +1741,41 @@ dragEnterEvent(QDragEnterEvent *event)
   event->acceptProposedAction();
 }
 
-// handle drag move
+// handle drag move (show insertion marker at drop position)
 void
 CQTabBar::
 dragMoveEvent(QDragMoveEvent *event)
 {
-  QString name;
-  int     fromIndex;
+  CQTabBar *bar;
+  QString   name;
+  int       fromIndex;
 
-  if (! dragValid(event->mimeData(), name, fromIndex)) {
+  // only drags from a tab bar in this process can be handled
+  if (! dragValid(event->mimeData(), bar, name, fromIndex) || ! bar) {
     event->ignore();
     return;
   }
 
-  if (dragPosValid(name, event->pos()))
+  int k = dropPosAt(event->pos());
+
+  if (dragPosValid(bar, fromIndex, k)) {
+    setDropPos(k);
+
     event->acceptProposedAction();
-  else
+  }
+  else {
+    setDropPos(-1);
+
     event->ignore();
+  }
+}
+
+// handle drag leave
+void
+CQTabBar::
+dragLeaveEvent(QDragLeaveEvent *)
+{
+  setDropPos(-1);
 }
 
 // handle drop event
@@ -907,56 +1783,73 @@ void
 CQTabBar::
 dropEvent(QDropEvent *event)
 {
-  QString name;
-  int     fromIndex;
+  setDropPos(-1);
 
-  if (! dragValid(event->mimeData(), name, fromIndex)) {
+  CQTabBar *bar;
+  QString   name;
+  int       fromIndex;
+
+  // only drags from a tab bar in this process can be handled
+  if (! dragValid(event->mimeData(), bar, name, fromIndex) || ! bar) {
     event->ignore();
     return;
   }
 
-  if (! dragPosValid(name, event->pos()))
+  // get visible tab insertion position at release position
+  int k = dropPosAt(event->pos());
+
+  if (! dragPosValid(bar, fromIndex, k)) {
+    event->ignore();
     return;
+  }
 
-  // get index at release position
-  int toIndex = tabAt(event->pos());
+  int nv = visibleTabs_.size();
 
-  if (name == objectName()) {
-    // skip invalid and do nothing drops
-    if (fromIndex < 0 || toIndex < 0 || fromIndex == toIndex)
-      return;
+  int toPos = (k < nv ? visibleTabs_[k] : int(buttons_.size()));
+
+  if      (bar == this) {
+    // move tab to insertion position (tab indices are unchanged)
+    int fromPos = tabButtonPos(fromIndex);
 
-    int pos1 = tabButtonPos(fromIndex);
-    int pos2 = tabButtonPos(toIndex  );
+    if (toPos > fromPos)
+      --toPos;
 
-    CQTabBarButton *button1 = buttons_[pos1];
-    CQTabBarButton *button2 = buttons_[pos2];
+    CQTabBarButton *button = buttons_[fromPos];
 
-    buttons_[pos2] = button1;
-    buttons_[pos1] = button2;
+    buttons_.erase (buttons_.begin() + fromPos);
+    buttons_.insert(buttons_.begin() + toPos, button);
 
-    button1->setIndex(toIndex);
-    button2->setIndex(fromIndex);
+    updateTabPositions(std::min(fromPos, toPos));
 
-    if      (fromIndex == currentIndex()) setCurrentIndex(toIndex);
-    else if (toIndex   == currentIndex()) setCurrentIndex(fromIndex);
+    layoutTabs();
 
-    emit tabMoved(fromIndex, toIndex);
+    emit tabMoved(fromIndex, toPos);
 
     event->acceptProposedAction();
   }
   else {
-    emit tabMovePageSignal(name, fromIndex, this->objectName(), toIndex);
+    // in-process drag from another tab bar
+    emit tabMovePage(bar, fromIndex, toPos);
 
     event->acceptProposedAction();
   }
 }
 
-// is drag valid
+// is drag valid (in-process drags skip mime data parsing)
 bool
 CQTabBar::
-dragValid(const QMimeData *m, QString &name, int &num) const
+dragValid(const QMimeData *m, CQTabBar *&bar, QString &name, int &num) const
 {
+  if (dragBar) {
+    bar  = dragBar;
+    name = bar->objectName();
+    num  = dragIndex;
+
+    return true;
+  }
+
+  bar = 0;
+
   // Only accept if it's our request
   QStringList formats = m->formats();
 
@@ -982,34 +1875,109 @@ dragValid(const QMimeData *m, QString &name, int &num) const
 // is drag position valid
 bool
 CQTabBar::
-dragPosValid(const QString &name, const QPoint &pos) const
+dragPosValid(CQTabBar *bar, int fromIndex, int k) const
 {
-  // drag in same tab bar must be to another tab
-  if (name == this->objectName()) {
-    int ind = tabAt(pos);
+  if (k < 0)
+    return false;
+
+  // drag in same tab bar must change tab order
+  if (bar == this) {
+    flushLayout();
+
+    CQTabBarButton *button = tabButton(fromIndex);
+
+    if (! button || ! button->visible())
+      return false;
+
+    std::vector<int>::const_iterator p =
+      std::lower_bound(visibleTabs_.begin(), visibleTabs_.end(), tabButtonPos(fromIndex));
+
+    int k1 = int(p - visibleTabs_.begin());
 
-    if (ind < 0)
+    if (k == k1 || k == k1 + 1)
       return false;
   }
 
   return true;
 }
 
+// get visible tab insertion position (0 to number of visible tabs) at point
+int
+CQTabBar::
+dropPosAt(const QPoint &point) const
+{
+  flushLayout();
+
+  int nv = visibleTabs_.size();
+
+  int x = (isVertical() ? point.y() : point.x()) + scrollOffset();
+
+  int k = visibleTabAt(x);
+
+  if (k < 0)
+    return (x < 0 ? 0 : nv);
+
+  // insert after tab if past its center
+  if (2*x > tabExtents_[k] + tabExtents_[k + 1])
+    ++k;
+
+  return k;
+}
+
+// set drop insertion position (redraw old and new marker)
+void
+CQTabBar::
+setDropPos(int k)
+{
+  if (k == dropPos_)
+    return;
+
+  if (dropPos_ >= 0)
+    update(dropMarkerRect(dropPos_));
+
+  dropPos_ = k;
+
+  if (dropPos_ >= 0)
+    update(dropMarkerRect(dropPos_));
+}
+
+// get drop insertion marker rectangle for visible tab position
+QRect
+CQTabBar::
+dropMarkerRect(int k) const
+{
+  int nv = visibleTabs_.size();
+
+  int x = (! tabExtents_.empty() ? tabExtents_[std::min(k, nv)] : 0) - scrollOffset();
+
+  if (isVertical())
+    return QRect(0, x - 2, h_, 4);
+  else
+    return QRect(x - 2, 0, 4, h_);
+}
+
 // get tab at specified point
 int
 CQTabBar::
 tabAt(const QPoint &point) const
 {
-  for (TabButtons::const_iterator p = buttons_.begin(); p != buttons_.end(); ++p) {
-    CQTabBarButton *button = *p;
+  flushLayout();
 
-    if (! button || ! button->visible()) continue;
+  // check inside tab row
+  int y = (isVertical() ? point.x() : point.y());
 
-    if (button->rect().contains(point))
-      return button->index();
-  }
+  if (y < 0 || y >= h_)
+    return -1;
+
+  // binary search of visible button extents
+  int x = (isVertical() ? point.y() : point.x()) + scrollOffset();
+
+  int k = visibleTabAt(x);
+
+  if (k < 0)
+    return -1;
 
-  return -1;
+  return buttons_[visibleTabs_[k]]->index();
 }
 
 // get icon size
@@ -1027,7 +1995,9 @@ setIconSize(const QSize &size)
 {
   iconSize_ = size;
 
-  update();
+  invalidateSizes();
+
+  layoutTabs();
 }
 
 // handle context menu request
@@ -1065,8 +2035,8 @@ isVertical() const
 CQTabBarButton::
 CQTabBarButton(CQTabBar *bar) :
  bar_(bar), index_(0), text_(), icon_(), positionIcon_(),
- iconPosition_(CQTabBar::North), toolTip_(), w_(0), visible_(true),
- pending_(false), r_()
+ positionIconKey_(), toolTip_(), w_(0), visible_(true),
+ pending_(false), count_(0), progress_(-1.0), r_(), width_(-1), staticTextValid_(false)
 {
 }
 
@@ -1076,6 +2046,11 @@ CQTabBarButton::
 setText(const QString &text)
 {
   text_ = text;
+
+  // keep lowercase text for tab filter up to date
+  lowerText_ = text.toLower();
+
+  invalidateWidth();
 }
 
 // set button icon
@@ -1086,8 +2061,8 @@ setIcon(const QIcon &icon)
   icon_ = icon;
 
   // ensure new icon causes recalc
-  if (iconPosition_ != CQTabBar::North && iconPosition_ != CQTabBar::South)
-    iconPosition_ = CQTabBar::North;
+  positionIcon_    = QIcon();
+  positionIconKey_ = QString();
 }
 
 // set button data
@@ -1106,18 +2081,30 @@ positionIcon(CQTabBar::Position pos) const
   if (pos == CQTabBar::North || pos == CQTabBar::South)
     return icon_;
 
-  if (pos == iconPosition_)
+  // rotated pixmaps are shared by all tab bars (key includes source icon cache key)
+  QSize size = bar_->iconSize();
+  qreal dpr  = bar_->devicePixelRatioF();
+
+  QString key = QString("CQTabBarIcon:%1:%2:%3x%4:%5").
+    arg(icon_.cacheKey()).arg(int(pos)).arg(size.width()).arg(size.height()).arg(dpr);
+
+  if (key == positionIconKey_)
     return positionIcon_;
 
-  iconPosition_ = pos;
+  QPixmap p;
 
-  QTransform t;
+  if (! QPixmapCache::find(key, &p)) {
+    QTransform t;
+
+    t.rotate(pos == CQTabBar::West ? 90 : -90);
 
-  QPixmap p = pixmap();
+    p = pixmap().transformed(t);
 
-  t.rotate(iconPosition_ == CQTabBar::West ? 90 : -90);
+    QPixmapCache::insert(key, p);
+  }
 
-  positionIcon_ = QIcon(p.transformed(t));
+  positionIcon_    = QIcon(p);
+  positionIconKey_ = key;
 
   return positionIcon_;
 }
@@ -1165,6 +2152,30 @@ setPending(bool pending)
   pending_ = pending;
 }
 
+// set button badge text
+void
+CQTabBarButton::
+setBadge(const QString &badge)
+{
+  badge_ = badge;
+}
+
+// set button count
+void
+CQTabBarButton::
+setCount(int count)
+{
+  count_ = count;
+}
+
+// set button progress
+void
+CQTabBarButton::
+setProgress(double progress)
+{
+  progress_ = progress;
+}
+
 // set tab rectangle
 void
 CQTabBarButton::
@@ -1178,34 +2189,290 @@ QPixmap
 CQTabBarButton::
 pixmap() const
 {
-  return icon_.pixmap(bar_->iconSize());
+  QSize size = bar_->iconSize();
+  qreal dpr  = bar_->devicePixelRatioF();
+
+  QPixmap p = icon_.pixmap(size*dpr);
+
+  // icon may not have pixmap for device size so use actual scale
+  if (size.width() > 0)
+    p.setDevicePixelRatio(qreal(p.width())/size.width());
+
+  return p;
 }
 
-// get button width depending on button style
+// get button width (cached)
 int
 CQTabBarButton::
 width() const
 {
-  QFontMetrics fm(bar_->font());
+  if (width_ < 0)
+    width_ = calcWidth();
 
-  //------
+  return width_;
+}
+
+// get label text shaped for bar font (prepared once until text or font changes)
+const QStaticText &
+CQTabBarButton::
+staticText() const
+{
+  if (! staticTextValid_) {
+    staticText_.setText(stripMnemonics(text_));
 
+    staticText_.setTextFormat(Qt::PlainText);
+
+    staticText_.prepare(QTransform(), bar_->font());
+
+    staticTextValid_ = true;
+  }
+
+  return staticText_;
+}
+
+// calc button width depending on button style
+int
+CQTabBarButton::
+calcWidth() const
+{
+  // text width from prepared label text (so text is only shaped once)
   Qt::ToolButtonStyle buttonStyle = bar_->buttonStyle();
 
   int w = 0;
 
   if      (buttonStyle == Qt::ToolButtonTextOnly)
-    w = fm.width(text()) + 24;
+    w = qCeil(staticText().size().width()) + 24;
   else if (buttonStyle == Qt::ToolButtonIconOnly)
     w = bar_->iconWidth() + 24;
   else
-    w = bar_->iconWidth() + fm.width(text()) + 32;
+    w = bar_->iconWidth() + qCeil(staticText().size().width()) + 32;
 
   return w;
 }
 
 //---------
 
+CQTabBarMenu::
+CQTabBarMenu(CQTabBar *bar) :
+ QFrame(bar, Qt::Popup), bar_(bar), itemsValid_(false)
+{
+  setObjectName("menu");
+
+  setFrameStyle(QFrame::StyledPanel | QFrame::Plain);
+
+  QVBoxLayout *layout = new QVBoxLayout(this);
+
+  layout->setMargin(2); layout->setSpacing(2);
+
+  edit_ = new QLineEdit;
+  list_ = new QListWidget;
+
+  edit_->setPlaceholderText("Filter");
+
+  edit_->installEventFilter(this);
+
+  layout->addWidget(edit_);
+  layout->addWidget(list_);
+
+  connect(edit_, SIGNAL(textChanged(const QString &)), this, SLOT(filterSlot(const QString &)));
+  connect(edit_, SIGNAL(returnPressed()), this, SLOT(activateSlot()));
+
+  // activate on return/double click, and on single click for styles which don't
+  connect(list_, SIGNAL(itemActivated(QListWidgetItem *)), this, SLOT(itemSlot(QListWidgetItem *)));
+
+  if (! style()->styleHint(QStyle::SH_ItemView_ActivateItemOnSingleClick, 0, list_))
+    connect(list_, SIGNAL(itemClicked(QListWidgetItem *)), this, SLOT(itemSlot(QListWidgetItem *)));
+
+  resize(250, 300);
+}
+
+// prepare list for popup (rebuilt from visible tabs only if tabs were added, removed,
+// moved, shown or hidden since last popup)
+void
+CQTabBarMenu::
+updateItems()
+{
+  edit_->blockSignals(true);
+  edit_->clear();
+  edit_->blockSignals(false);
+
+  filter_ = QString();
+
+  if (! itemsValid_)
+    rebuildItems();
+  else {
+    // clear previous filter
+    matches_.clear();
+
+    for (int i = 0; i < int(rows_.size()); ++i) {
+      list_->setRowHidden(i, false);
+
+      matches_.push_back(i);
+    }
+  }
+
+  IndexRows::const_iterator p = indexRows_.find(bar_->currentIndex());
+
+  list_->setCurrentRow(p != indexRows_.end() ? p.value() : -1);
+
+  edit_->setFocus();
+}
+
+// mark list as needing rebuild (tab order or visibility changed)
+void
+CQTabBarMenu::
+invalidateItems()
+{
+  itemsValid_ = false;
+}
+
+// update text and icon of item for tab index (lowercase text is maintained by the tab button)
+void
+CQTabBarMenu::
+updateItem(int ind)
+{
+  if (! itemsValid_)
+    return;
+
+  IndexRows::const_iterator p = indexRows_.find(ind);
+
+  if (p == indexRows_.end())
+    return;
+
+  CQTabBarButton *button = bar_->tabButton(ind);
+
+  if (! button)
+    return;
+
+  int row = p.value();
+
+  QListWidgetItem *item = list_->item(row);
+
+  item->setText(button->text());
+  item->setIcon(button->icon());
+
+  rows_[row].text = button->lowerText();
+}
+
+// rebuild list from visible tabs
+void
+CQTabBarMenu::
+rebuildItems()
+{
+  list_->clear();
+
+  rows_     .clear();
+  matches_  .clear();
+  indexRows_.clear();
+
+  for (std::vector<int>::const_iterator p = bar_->visibleTabs_.begin();
+         p != bar_->visibleTabs_.end(); ++p) {
+    CQTabBarButton *button = bar_->buttons_[*p];
+
+    QListWidgetItem *item = new QListWidgetItem(button->icon(), button->text());
+
+    list_->addItem(item);
+
+    indexRows_[button->index()] = int(rows_.size());
+
+    matches_.push_back(int(rows_.size()));
+
+    rows_.push_back(Row(button->index(), button->lowerText()));
+  }
+
+  itemsValid_ = true;
+}
+
+// filter rows by text (narrow previous matches if filter was extended)
+void
+CQTabBarMenu::
+filterSlot(const QString &text)
+{
+  QString filter = text.toLower();
+
+  if (filter.startsWith(filter_)) {
+    // only previous matches can match extended filter
+    RowNums matches;
+
+    for (RowNums::const_iterator p = matches_.begin(); p != matches_.end(); ++p) {
+      if (rows_[*p].text.contains(filter))
+        matches.push_back(*p);
+      else
+        list_->setRowHidden(*p, true);
+    }
+
+    matches_.swap(matches);
+  }
+  else {
+    matches_.clear();
+
+    for (int i = 0; i < int(rows_.size()); ++i) {
+      bool match = rows_[i].text.contains(filter);
+
+      list_->setRowHidden(i, ! match);
+
+      if (match)
+        matches_.push_back(i);
+    }
+  }
+
+  filter_ = filter;
+
+  if (! matches_.empty())
+    list_->setCurrentRow(matches_[0]);
+}
+
+// handle return in filter (select current match)
+void
+CQTabBarMenu::
+activateSlot()
+{
+  QListWidgetItem *item = list_->currentItem();
+
+  if (item && ! list_->isRowHidden(list_->row(item)))
+    itemSlot(item);
+}
+
+// select tab for item and close
+void
+CQTabBarMenu::
+itemSlot(QListWidgetItem *item)
+{
+  int row = list_->row(item);
+
+  if (row < 0 || row >= int(rows_.size()))
+    return;
+
+  int ind = rows_[row].index;
+
+  hide();
+
+  bar_->setCurrentIndex(ind);
+
+  bar_->ensureTabVisible(ind);
+}
+
+// forward up/down keys in filter to list
+bool
+CQTabBarMenu::
+eventFilter(QObject *obj, QEvent *e)
+{
+  if (obj == edit_ && e->type() == QEvent::KeyPress) {
+    QKeyEvent *ke = static_cast<QKeyEvent *>(e);
+
+    if (ke->key() == Qt::Key_Up   || ke->key() == Qt::Key_Down ||
+        ke->key() == Qt::Key_PageUp || ke->key() == Qt::Key_PageDown) {
+      QApplication::sendEvent(list_, e);
+
+      return true;
+    }
+  }
+
+  return QFrame::eventFilter(obj, e);
+}
+
+//---------
+
 CQTabBarScrollButton::
 CQTabBarScrollButton(CQTabBar *bar, const char *name) :
  QToolButton(bar)
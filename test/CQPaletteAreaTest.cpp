@@ -34,10 +34,8 @@ class PageAction {
 
   virtual ~PageAction() { }
 
-  virtual QString title() const = 0;
-
-  QAction *createAction(QMenu *menu) {
-    action_ = new QAction(title(), menu);
+  QAction *createAction(QMenu *menu, const QString &title) {
+    action_ = new QAction(title, menu);
 
     action_->setCheckable(true);
     action_->setChecked(true);
@@ -55,13 +53,7 @@ class TransformPage : public CQPaletteAreaPage, public PageAction {
  public:
   TransformPage();
 
-  QString title      () const { return "Transform"; }
   QString windowTitle() const { return "Transform Page"; }
-  QIcon   icon       () const { return QIcon(QPixmap((const char **) transform_data)); }
-
-  Qt::DockWidgetAreas allowedAreas() const {
-    return Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea;
-  }
 
   void setHidden(bool hidden) {
     if (action_)
@@ -75,13 +67,7 @@ class PenPage : public CQPaletteAreaPage, public PageAction {
  public:
   PenPage();
 
-  QString title      () const { return "Pen"; }
   QString windowTitle() const { return "Pen Page"; }
-  QIcon   icon       () const { return QIcon(QPixmap((const char **) pen_data)); }
-
-  Qt::DockWidgetAreas allowedAreas() const {
-    return Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea;
-  }
 
   void setHidden(bool hidden) {
     if (hidden) action_->setChecked(false);
@@ -94,13 +80,7 @@ class BrushPage : public CQPaletteAreaPage, public PageAction {
  public:
   BrushPage();
 
-  QString title      () const { return "Brush"; }
   QString windowTitle() const { return "Brush Page"; }
-  QIcon   icon       () const { return QIcon(QPixmap((const char **) brush_data)); }
-
-  Qt::DockWidgetAreas allowedAreas() const {
-    return Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea;
-  }
 
   void setHidden(bool hidden) {
     if (hidden) action_->setChecked(false);
@@ -113,13 +93,7 @@ class ConsolePage : public CQPaletteAreaPage, public PageAction {
  public:
   ConsolePage();
 
-  QString title      () const { return "Console"; }
   QString windowTitle() const { return "Console Page"; }
-  QIcon   icon       () const { return QIcon(QPixmap((const char **) console_data)); }
-
-  Qt::DockWidgetAreas allowedAreas() const {
-    return Qt::TopDockWidgetArea | Qt::BottomDockWidgetArea;
-  }
 
   void setHidden(bool hidden) {
     if (hidden) action_->setChecked(false);
@@ -132,14 +106,7 @@ class MRUPage : public CQPaletteAreaPage, public PageAction {
  public:
   MRUPage();
 
-  QString title      () const { return "MRU"; }
   QString windowTitle() const { return "MRU Page"; }
-  QIcon   icon       () const { return QIcon(QPixmap((const char **) mru_data)); }
-
-  Qt::DockWidgetAreas allowedAreas() const {
-    return Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea |
-           Qt::TopDockWidgetArea | Qt::BottomDockWidgetArea;
-  }
 
   void setHidden(bool hidden) {
     if (hidden) action_->setChecked(false);
@@ -177,8 +144,8 @@ CQPaletteAreaTest() :
   consolePage_   = new ConsolePage  ();
   mruPage_       = new MRUPage      ();
 
-  //connect(consolePage_, SIGNAL(pageShown ()), this, SLOT(consoleShown ()));
-  //connect(consolePage_, SIGNAL(pageHidden()), this, SLOT(consoleHidden()));
+  connect(consolePage_, SIGNAL(pageShown ()), this, SLOT(consoleShown ()));
+  connect(consolePage_, SIGNAL(pageHidden()), this, SLOT(consoleHidden()));
 
   mgr_->addPage(transformPage_, Qt::LeftDockWidgetArea);
   mgr_->addPage(penPage_      , Qt::LeftDockWidgetArea);
@@ -199,11 +166,11 @@ CQPaletteAreaTest() :
 
   QMenu *paletteMenu = menuBar()->addMenu("&Palette");
 
-  QAction *page1Action = transformPage_->createAction(paletteMenu);
-  QAction *page2Action = penPage_      ->createAction(paletteMenu);
-  QAction *page3Action = brushPage_    ->createAction(paletteMenu);
-  QAction *page4Action = consolePage_  ->createAction(paletteMenu);
-  QAction *page5Action = mruPage_      ->createAction(paletteMenu);
+  QAction *page1Action = transformPage_->createAction(paletteMenu, transformPage_->title());
+  QAction *page2Action = penPage_      ->createAction(paletteMenu, penPage_      ->title());
+  QAction *page3Action = brushPage_    ->createAction(paletteMenu, brushPage_    ->title());
+  QAction *page4Action = consolePage_  ->createAction(paletteMenu, consolePage_  ->title());
+  QAction *page5Action = mruPage_      ->createAction(paletteMenu, mruPage_      ->title());
 
   connect(page1Action, SIGNAL(triggered(bool)), this, SLOT(transformSlot(bool)));
   connect(page2Action, SIGNAL(triggered(bool)), this, SLOT(penSlot(bool)));
@@ -323,6 +290,10 @@ TransformPage::
 TransformPage() :
  CQPaletteAreaPage(new PageWidget)
 {
+  setTitle("Transform");
+  setIcon(QIcon(QPixmap((const char **) transform_data)));
+  setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
+
   QWidget *w = widget();
 
   w->setObjectName("transform");
@@ -342,6 +313,10 @@ PenPage::
 PenPage() :
  CQPaletteAreaPage(new PageWidget)
 {
+  setTitle("Pen");
+  setIcon(QIcon(QPixmap((const char **) pen_data)));
+  setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
+
   QWidget *w = widget();
 
   w->setObjectName("pen");
@@ -361,6 +336,10 @@ BrushPage::
 BrushPage() :
  CQPaletteAreaPage(new PageWidget)
 {
+  setTitle("Brush");
+  setIcon(QIcon(QPixmap((const char **) brush_data)));
+  setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
+
   QWidget *w = widget();
 
   w->setObjectName("brush");
@@ -390,6 +369,10 @@ ConsolePage::
 ConsolePage() :
  CQPaletteAreaPage(new PageWidget)
 {
+  setTitle("Console");
+  setIcon(QIcon(QPixmap((const char **) console_data)));
+  setAllowedAreas(Qt::TopDockWidgetArea | Qt::BottomDockWidgetArea);
+
   QWidget *w = widget();
 
   w->setObjectName("console");
@@ -408,6 +391,10 @@ MRUPage::
 MRUPage() :
  CQPaletteAreaPage(new PageWidget)
 {
+  setTitle("MRU");
+  setIcon(QIcon(QPixmap((const char **) mru_data)));
+  setAllowedAreas(Qt::AllDockWidgetAreas);
+
   QWidget *w = widget();
 
   w->setObjectName("mru");
@@ -4,7 +4,7 @@ TARGET = CQPaletteAreaTest
 
 DEPENDPATH += .
 
-QT += widgets
+QT += widgets concurrent
 
 #CONFIG += debug
 